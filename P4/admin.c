@@ -0,0 +1,126 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "admin.h"
+
+#define ADMIN_LINE_LEN 256
+#define ADMIN_TIMEOUT_SEC 5
+
+// Write a formatted reply line to an admin client
+static void reply(int fd, const char *format, ...)
+{
+    char line[ADMIN_LINE_LEN];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (len < 0)
+        return;
+    if (len >= (int)sizeof(line))
+        len = sizeof(line) - 1;
+    write(fd, line, len);
+}
+
+static void reply_player(int fd, const char *prefix, const PlayerStats *p)
+{
+    reply(fd, "%s%s wins=%u losses=%u forfeits=%u streak=%d best_streak=%u last_seen=%lld\n",
+          prefix, p->name, p->wins, p->losses, p->forfeits, p->streak, p->best_streak,
+          (long long)p->last_seen);
+}
+
+// Run one admin command
+static void handle_command(int fd, char *line, StatsTable *stats)
+{
+    char *cmd = strtok(line, " \t\r\n");
+    char *arg = strtok(NULL, "\r\n");
+
+    if (cmd == NULL)
+        return;
+
+    if (strcmp(cmd, "top") == 0)
+    {
+        PlayerStats board[LEADERBOARD_SIZE];
+        int max = arg ? atoi(arg) : LEADERBOARD_SIZE;
+        if (max <= 0 || max > LEADERBOARD_SIZE)
+            max = LEADERBOARD_SIZE;
+        int n = stats_leaderboard(stats, board, max);
+        for (int i = 0; i < n; i++)
+        {
+            char rank[16];
+            snprintf(rank, sizeof(rank), "%d. ", i + 1);
+            reply_player(fd, rank, &board[i]);
+        }
+        reply(fd, "END\n");
+    }
+    else if (strcmp(cmd, "player") == 0 && arg)
+    {
+        PlayerStats p;
+        if (stats_lookup(stats, arg, &p) == 0)
+            reply_player(fd, "", &p);
+        else
+            reply(fd, "NOTFOUND %s\n", arg);
+    }
+    else if (strcmp(cmd, "count") == 0)
+    {
+        reply(fd, "players=%u\n", stats_player_count(stats));
+    }
+    else
+    {
+        reply(fd, "ERROR commands: top [n] | player <name> | count\n");
+    }
+}
+
+// Serve admin clients forever. Each client may send any number of
+// newline-terminated commands; reads only touch the stats table through
+// its sequence lock, so they never delay a game process.
+void admin_serve(int listen_fd, StatsTable *stats)
+{
+    for (;;)
+    {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("admin accept");
+            return;
+        }
+
+        // Don't let an idle client hold the admin socket forever
+        struct timeval tv = { ADMIN_TIMEOUT_SEC, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        char buf[ADMIN_LINE_LEN];
+        int used = 0;
+        for (;;)
+        {
+            int bytes = read(fd, buf + used, sizeof(buf) - 1 - used);
+            if (bytes <= 0)
+                break;
+            used += bytes;
+            buf[used] = '\0';
+
+            char *start = buf;
+            char *nl;
+            while ((nl = strchr(start, '\n')) != NULL)
+            {
+                *nl = '\0';
+                handle_command(fd, start, stats);
+                start = nl + 1;
+            }
+
+            // Keep any partial command; drop one that overflows the buffer
+            used = strlen(start);
+            memmove(buf, start, used + 1);
+            if (used == (int)sizeof(buf) - 1)
+                used = 0;
+        }
+        close(fd);
+    }
+}
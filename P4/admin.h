@@ -0,0 +1,8 @@
+#ifndef ADMIN_H
+#define ADMIN_H
+
+#include "stats.h"
+
+void admin_serve(int listen_fd, StatsTable *stats);
+
+#endif
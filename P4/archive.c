@@ -0,0 +1,353 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "archive.h"
+
+#define GAMES_MAGIC "NIMARC1"
+#define NAMES_MAGIC "NIMNAM1"
+#define ARCHIVE_VERSION 1
+#define NAME_BUCKETS 65536
+#define NAME_ENTRY_SIZE 80
+
+// File headers, each padded out to ARCHIVE_HEADER_SIZE on disk
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_rows;
+    uint64_t rows;                // committed rows; bumped last on append
+} GamesHeader;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t buckets;
+    uint32_t count;
+} NamesHeader;
+
+// Name entry: chain link (entry id + 1, 0 ends the chain) then the name
+typedef struct {
+    uint32_t next;
+    char name[NAME_ENTRY_SIZE - sizeof(uint32_t)];
+} NameEntry;
+
+#define BUCKETS_OFFSET ARCHIVE_HEADER_SIZE
+#define ENTRIES_OFFSET (BUCKETS_OFFSET + NAME_BUCKETS * sizeof(uint32_t))
+
+// FNV-1a, used to pick a name bucket
+static uint32_t hash_name(const char *name)
+{
+    uint32_t h = 2166136261u;
+    for (; *name; name++)
+    {
+        h ^= (unsigned char)*name;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int open_file(const char *dir, const char *file, int flags)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    return open(path, flags, 0644);
+}
+
+// Write a full buffer at an offset, retrying short writes
+static int pwrite_all(int fd, const void *buf, size_t len, off_t off)
+{
+    const char *p = buf;
+    while (len > 0)
+    {
+        ssize_t n = pwrite(fd, p, len, off);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+        off += n;
+    }
+    return 0;
+}
+
+static int pread_all(int fd, void *buf, size_t len, off_t off)
+{
+    return pread(fd, buf, len, off) == (ssize_t)len ? 0 : -1;
+}
+
+// Create the archive directory and empty files if they do not exist yet
+int archive_init(const char *dir)
+{
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+    {
+        perror("archive mkdir");
+        return -1;
+    }
+
+    int games_fd = open_file(dir, "games.nca", O_RDWR | O_CREAT);
+    int names_fd = open_file(dir, "names.nca", O_RDWR | O_CREAT);
+    if (games_fd < 0 || names_fd < 0)
+    {
+        perror("archive open");
+        if (games_fd >= 0) close(games_fd);
+        if (names_fd >= 0) close(names_fd);
+        return -1;
+    }
+
+    int result = 0;
+    flock(games_fd, LOCK_EX);
+
+    struct stat st;
+    fstat(games_fd, &st);
+    if (st.st_size == 0)
+    {
+        GamesHeader gh;
+        memset(&gh, 0, sizeof(gh));
+        memcpy(gh.magic, GAMES_MAGIC, sizeof(gh.magic));
+        gh.version = ARCHIVE_VERSION;
+        gh.block_rows = ARCHIVE_BLOCK_ROWS;
+        if (ftruncate(games_fd, ARCHIVE_HEADER_SIZE) < 0 ||
+            pwrite_all(games_fd, &gh, sizeof(gh), 0) < 0)
+            result = -1;
+    }
+    else
+    {
+        GamesHeader gh;
+        if (pread_all(games_fd, &gh, sizeof(gh), 0) < 0 ||
+            memcmp(gh.magic, GAMES_MAGIC, sizeof(gh.magic)) != 0 ||
+            gh.version != ARCHIVE_VERSION || gh.block_rows != ARCHIVE_BLOCK_ROWS)
+        {
+            fprintf(stderr, "%s/games.nca: not a version %d archive\n", dir, ARCHIVE_VERSION);
+            result = -1;
+        }
+    }
+
+    fstat(names_fd, &st);
+    if (result == 0 && st.st_size == 0)
+    {
+        NamesHeader nh;
+        memset(&nh, 0, sizeof(nh));
+        memcpy(nh.magic, NAMES_MAGIC, sizeof(nh.magic));
+        nh.version = ARCHIVE_VERSION;
+        nh.buckets = NAME_BUCKETS;
+        if (ftruncate(names_fd, ENTRIES_OFFSET) < 0 ||
+            pwrite_all(names_fd, &nh, sizeof(nh), 0) < 0)
+            result = -1;
+    }
+
+    flock(games_fd, LOCK_UN);
+    close(games_fd);
+    close(names_fd);
+    return result;
+}
+
+// Look a name up in names.nca, adding it if missing. Caller holds the lock.
+static int intern_name(int fd, const char *name, uint32_t *id)
+{
+    NamesHeader nh;
+    if (pread_all(fd, &nh, sizeof(nh), 0) < 0)
+        return -1;
+
+    off_t bucket_off = BUCKETS_OFFSET + (hash_name(name) % nh.buckets) * sizeof(uint32_t);
+    uint32_t head;
+    if (pread_all(fd, &head, sizeof(head), bucket_off) < 0)
+        return -1;
+
+    for (uint32_t link = head; link != 0; )
+    {
+        NameEntry entry;
+        if (pread_all(fd, &entry, sizeof(entry), ENTRIES_OFFSET + (off_t)(link - 1) * NAME_ENTRY_SIZE) < 0)
+            return -1;
+        if (strncmp(entry.name, name, sizeof(entry.name)) == 0)
+        {
+            *id = link - 1;
+            return 0;
+        }
+        link = entry.next;
+    }
+
+    // Not found: append a new entry and make it the bucket's head
+    NameEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.next = head;
+    strncpy(entry.name, name, sizeof(entry.name) - 1);
+
+    uint32_t new_id = nh.count;
+    uint32_t link = new_id + 1;
+    nh.count++;
+    if (pwrite_all(fd, &entry, sizeof(entry), ENTRIES_OFFSET + (off_t)new_id * NAME_ENTRY_SIZE) < 0 ||
+        pwrite_all(fd, &link, sizeof(link), bucket_off) < 0 ||
+        pwrite_all(fd, &nh, sizeof(nh), 0) < 0)
+        return -1;
+
+    *id = new_id;
+    return 0;
+}
+
+// Append one finished game. Concurrent writers from different game processes
+// are serialized with flock() on games.nca; the row only becomes visible to
+// readers when the row count in the header is bumped.
+int archive_append(const char *dir, const GameRecord *rec)
+{
+    int games_fd = open_file(dir, "games.nca", O_RDWR);
+    if (games_fd < 0)
+        return -1;
+    int names_fd = open_file(dir, "names.nca", O_RDWR);
+    if (names_fd < 0)
+    {
+        close(games_fd);
+        return -1;
+    }
+
+    flock(games_fd, LOCK_EX);
+
+    int result = -1;
+    GamesHeader gh;
+    uint32_t p1_id, p2_id;
+    if (pread_all(games_fd, &gh, sizeof(gh), 0) < 0 ||
+        intern_name(names_fd, rec->p1, &p1_id) < 0 ||
+        intern_name(names_fd, rec->p2, &p2_id) < 0)
+        goto out;
+
+    uint64_t block = gh.rows / ARCHIVE_BLOCK_ROWS;
+    uint64_t row = gh.rows % ARCHIVE_BLOCK_ROWS;
+    off_t base = ARCHIVE_HEADER_SIZE + (off_t)block * ARCHIVE_BLOCK_SIZE;
+
+    // Grow the file a whole block at a time; untouched columns stay sparse
+    if (row == 0 && ftruncate(games_fd, base + ARCHIVE_BLOCK_SIZE) < 0)
+        goto out;
+
+    uint8_t moves[ARCHIVE_MAX_MOVES];
+    memset(moves, 0, sizeof(moves));
+    memcpy(moves, rec->moves, rec->move_count <= ARCHIVE_MAX_MOVES ? rec->move_count : ARCHIVE_MAX_MOVES);
+
+    if (pwrite_all(games_fd, &p1_id, 4, base + ARCHIVE_COL_P1 + row * 4) < 0 ||
+        pwrite_all(games_fd, &p2_id, 4, base + ARCHIVE_COL_P2 + row * 4) < 0 ||
+        pwrite_all(games_fd, &rec->end_time, 8, base + ARCHIVE_COL_END + row * 8) < 0 ||
+        pwrite_all(games_fd, &rec->duration_ms, 4, base + ARCHIVE_COL_DURATION + row * 4) < 0 ||
+        pwrite_all(games_fd, &rec->winner, 1, base + ARCHIVE_COL_WINNER + row) < 0 ||
+        pwrite_all(games_fd, &rec->forfeit, 1, base + ARCHIVE_COL_FORFEIT + row) < 0 ||
+        pwrite_all(games_fd, &rec->move_count, 1, base + ARCHIVE_COL_NMOVES + row) < 0 ||
+        pwrite_all(games_fd, moves, ARCHIVE_MAX_MOVES,
+                   base + ARCHIVE_COL_MOVES + row * ARCHIVE_MAX_MOVES) < 0)
+        goto out;
+
+    // Commit the row
+    gh.rows++;
+    if (pwrite_all(games_fd, &gh.rows, sizeof(gh.rows), offsetof(GamesHeader, rows)) < 0)
+        goto out;
+    result = 0;
+
+out:
+    flock(games_fd, LOCK_UN);
+    close(names_fd);
+    close(games_fd);
+    return result;
+}
+
+static void *map_file(const char *dir, const char *file, size_t *len)
+{
+    int fd = open_file(dir, file, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < ARCHIVE_HEADER_SIZE)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    *len = st.st_size;
+    return map;
+}
+
+// Map an archive read-only. Rows appended after this call are not visible.
+int archive_open(const char *dir, Archive *ar)
+{
+    memset(ar, 0, sizeof(*ar));
+    ar->games_map = map_file(dir, "games.nca", &ar->games_len);
+    ar->names_map = map_file(dir, "names.nca", &ar->names_len);
+    if (!ar->games_map || !ar->names_map)
+    {
+        fprintf(stderr, "%s: cannot map archive\n", dir);
+        archive_close(ar);
+        return -1;
+    }
+
+    const GamesHeader *gh = ar->games_map;
+    const NamesHeader *nh = ar->names_map;
+    if (memcmp(gh->magic, GAMES_MAGIC, sizeof(gh->magic)) != 0 ||
+        memcmp(nh->magic, NAMES_MAGIC, sizeof(nh->magic)) != 0 ||
+        gh->version != ARCHIVE_VERSION || gh->block_rows != ARCHIVE_BLOCK_ROWS)
+    {
+        fprintf(stderr, "%s: not a version %d archive\n", dir, ARCHIVE_VERSION);
+        archive_close(ar);
+        return -1;
+    }
+
+    // Trust only what the mapped lengths can hold
+    uint64_t blocks = (ar->games_len - ARCHIVE_HEADER_SIZE) / ARCHIVE_BLOCK_SIZE;
+    ar->rows = gh->rows;
+    if (ar->rows > blocks * ARCHIVE_BLOCK_ROWS)
+        ar->rows = blocks * ARCHIVE_BLOCK_ROWS;
+
+    ar->name_count = nh->count;
+    if (ar->names_len < ENTRIES_OFFSET ||
+        ar->name_count > (ar->names_len - ENTRIES_OFFSET) / NAME_ENTRY_SIZE)
+        ar->name_count = ar->names_len < ENTRIES_OFFSET ? 0
+                       : (ar->names_len - ENTRIES_OFFSET) / NAME_ENTRY_SIZE;
+
+    ar->games = (const char *)ar->games_map + ARCHIVE_HEADER_SIZE;
+    ar->names = (const char *)ar->names_map + ENTRIES_OFFSET;
+    return 0;
+}
+
+void archive_close(Archive *ar)
+{
+    if (ar->games_map)
+        munmap(ar->games_map, ar->games_len);
+    if (ar->names_map)
+        munmap(ar->names_map, ar->names_len);
+    memset(ar, 0, sizeof(*ar));
+}
+
+// Name for an interned id, or "?" if out of range
+const char *archive_name(const Archive *ar, uint32_t id)
+{
+    if (id >= ar->name_count)
+        return "?";
+    return ((const NameEntry *)(ar->names + (size_t)id * NAME_ENTRY_SIZE))->name;
+}
+
+// Resolve a player name to its id through the hash buckets
+int archive_find_name(const Archive *ar, const char *name, uint32_t *id)
+{
+    const uint32_t *buckets = (const uint32_t *)((const char *)ar->names_map + BUCKETS_OFFSET);
+    uint32_t link = buckets[hash_name(name) % NAME_BUCKETS];
+    while (link != 0 && link <= ar->name_count)
+    {
+        const NameEntry *entry = (const NameEntry *)(ar->names + (size_t)(link - 1) * NAME_ENTRY_SIZE);
+        if (strncmp(entry->name, name, sizeof(entry->name)) == 0)
+        {
+            *id = link - 1;
+            return 0;
+        }
+        link = entry->next;
+    }
+    return -1;
+}
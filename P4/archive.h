@@ -0,0 +1,71 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Columnar archive of completed games. An archive is a directory holding
+// games.nca (fixed-width columns, stored in blocks of ARCHIVE_BLOCK_ROWS
+// rows) and names.nca (interned player names, referenced by 32-bit id).
+// All integers are stored in host byte order.
+
+#define ARCHIVE_BLOCK_ROWS 65536
+#define ARCHIVE_MAX_MOVES 25      // total stones on the board
+#define ARCHIVE_NAME_LEN 73
+#define ARCHIVE_HEADER_SIZE 4096
+
+// Packed move byte: pile in the high nibble, stones in the low nibble
+#define ARCHIVE_MOVE(pile, stones) (uint8_t)(((pile) << 4) | (stones))
+#define ARCHIVE_MOVE_PILE(m) ((m) >> 4)
+#define ARCHIVE_MOVE_STONES(m) ((m) & 0x0f)
+
+// One finished game, as handed to archive_append()
+typedef struct {
+    char p1[ARCHIVE_NAME_LEN];
+    char p2[ARCHIVE_NAME_LEN];
+    uint8_t winner;               // 1 or 2, 0 if the game had no result
+    uint8_t forfeit;
+    uint8_t move_count;
+    uint8_t moves[ARCHIVE_MAX_MOVES];
+    int64_t end_time;             // seconds since the epoch
+    uint32_t duration_ms;
+} GameRecord;
+
+// Column layout of one block, as byte offsets from the start of the block
+#define ARCHIVE_COL_P1       0
+#define ARCHIVE_COL_P2       (ARCHIVE_COL_P1 + 4 * ARCHIVE_BLOCK_ROWS)
+#define ARCHIVE_COL_END      (ARCHIVE_COL_P2 + 4 * ARCHIVE_BLOCK_ROWS)
+#define ARCHIVE_COL_DURATION (ARCHIVE_COL_END + 8 * ARCHIVE_BLOCK_ROWS)
+#define ARCHIVE_COL_WINNER   (ARCHIVE_COL_DURATION + 4 * ARCHIVE_BLOCK_ROWS)
+#define ARCHIVE_COL_FORFEIT  (ARCHIVE_COL_WINNER + ARCHIVE_BLOCK_ROWS)
+#define ARCHIVE_COL_NMOVES   (ARCHIVE_COL_FORFEIT + ARCHIVE_BLOCK_ROWS)
+#define ARCHIVE_COL_MOVES    (ARCHIVE_COL_NMOVES + ARCHIVE_BLOCK_ROWS)
+#define ARCHIVE_BLOCK_SIZE   (ARCHIVE_COL_MOVES + ARCHIVE_MAX_MOVES * ARCHIVE_BLOCK_ROWS)
+
+// Read-only view of an archive, mapped for scanning
+typedef struct {
+    const char *games;            // start of block 0
+    const char *names;            // start of the name entries
+    uint64_t rows;
+    uint32_t name_count;
+    size_t games_len;
+    size_t names_len;
+    void *games_map;
+    void *names_map;
+} Archive;
+
+int archive_init(const char *dir);
+int archive_append(const char *dir, const GameRecord *rec);
+
+int archive_open(const char *dir, Archive *ar);
+void archive_close(Archive *ar);
+const char *archive_name(const Archive *ar, uint32_t id);
+int archive_find_name(const Archive *ar, const char *name, uint32_t *id);
+
+// Base address of a block's column; rows in the block are contiguous
+static inline const void *archive_column(const Archive *ar, uint64_t block, size_t col)
+{
+    return ar->games + block * (uint64_t)ARCHIVE_BLOCK_SIZE + col;
+}
+
+#endif
@@ -0,0 +1,527 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <endian.h>
+#include <netdb.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+#include "cluster.h"
+#include "ngp.h"
+
+#define CLUSTER_SLOTS 4096            // remote claims, open addressing
+#define CLUSTER_MAX_LOCAL 1024
+#define CLUSTER_MAGIC 0x4e494d47u     // "NIMG"
+#define CLUSTER_BATCH 14              // claims per datagram, fits a 1400-byte MTU
+
+enum { SLOT_FREE = 0, SLOT_USED, SLOT_DEAD };
+enum { OP_CLAIM = 1, OP_RELEASE };
+
+// A claim held by another node. Only the gossip process writes these;
+// other processes probe them without locking.
+typedef struct {
+    uint32_t state;
+    uint32_t node;
+    uint64_t claimed_at;       // owner's wall clock, ms; orders conflicting claims
+    uint64_t expires;          // local CLOCK_MONOTONIC, ms
+    char name[MAX_NAME_LEN];
+} Claim;
+
+struct Cluster {
+    uint32_t node_id;
+    int udp_fd;
+    int local_fd[2];           // parent -> gossip process, one datagram per change
+    int peer_count;
+    struct sockaddr_storage peers[CLUSTER_MAX_PEERS];
+    socklen_t peer_len[CLUSTER_MAX_PEERS];
+    ClusterStats stats;        // written by the gossip process
+    Claim claims[CLUSTER_SLOTS];
+};
+
+// On the wire, all integers are big-endian
+typedef struct {
+    uint32_t magic;
+    uint32_t node;
+    uint16_t count;
+    uint16_t pad;
+} WireHeader;
+
+typedef struct {
+    uint8_t op;
+    uint8_t pad[7];
+    uint64_t claimed_at;
+    char name[MAX_NAME_LEN];
+} WireClaim;
+
+// Change reported by the parent
+typedef struct {
+    uint8_t op;
+    char name[MAX_NAME_LEN];
+} LocalChange;
+
+// A name held by a player on this node (gossip process only)
+typedef struct {
+    uint64_t claimed_at;
+    int lost;                  // another node won it; stop renewing
+    char name[MAX_NAME_LEN];
+} LocalClaim;
+
+static LocalClaim local[CLUSTER_MAX_LOCAL];
+static int local_count;
+
+static struct {
+    WireHeader header;
+    WireClaim claims[CLUSTER_BATCH];
+} batch;
+static uint64_t batch_deadline;
+
+static uint64_t now_ms(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// FNV-1a over the player name
+static uint32_t hash_name(const char *name)
+{
+    uint32_t h = 2166136261u;
+    for (; *name; name++)
+    {
+        h ^= (unsigned char)*name;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int open_udp(const char *port)
+{
+    struct addrinfo hint, *info_list, *info;
+    memset(&hint, 0, sizeof(hint));
+    hint.ai_family = AF_INET;
+    hint.ai_socktype = SOCK_DGRAM;
+    hint.ai_flags = AI_PASSIVE;
+
+    int error = getaddrinfo(NULL, port, &hint, &info_list);
+    if (error)
+    {
+        fprintf(stderr, "cluster port %s: %s\n", port, gai_strerror(error));
+        return -1;
+    }
+
+    int fd = -1;
+    for (info = info_list; info != NULL; info = info->ai_next)
+    {
+        fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+        if (fd < 0)
+            continue;
+        if (bind(fd, info->ai_addr, info->ai_addrlen) == 0)
+            break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(info_list);
+    if (fd < 0)
+        fprintf(stderr, "Could not bind cluster port %s\n", port);
+    return fd;
+}
+
+static int add_peer(Cluster *cluster, char *peer)
+{
+    char *colon = strrchr(peer, ':');
+    if (!colon || cluster->peer_count == CLUSTER_MAX_PEERS)
+    {
+        fprintf(stderr, "Bad cluster peer %s\n", peer);
+        return -1;
+    }
+    *colon = '\0';
+
+    struct addrinfo hint, *info;
+    memset(&hint, 0, sizeof(hint));
+    hint.ai_family = AF_INET;
+    hint.ai_socktype = SOCK_DGRAM;
+    int error = getaddrinfo(peer, colon + 1, &hint, &info);
+    if (error)
+    {
+        fprintf(stderr, "cluster peer %s:%s: %s\n", peer, colon + 1, gai_strerror(error));
+        return -1;
+    }
+    memcpy(&cluster->peers[cluster->peer_count], info->ai_addr, info->ai_addrlen);
+    cluster->peer_len[cluster->peer_count] = info->ai_addrlen;
+    cluster->peer_count++;
+    freeaddrinfo(info);
+    return 0;
+}
+
+Cluster *cluster_create(const char *port, const char *peers)
+{
+    Cluster *cluster = mmap(NULL, sizeof(Cluster), PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (cluster == MAP_FAILED)
+    {
+        perror("cluster mmap failed");
+        return NULL;
+    }
+
+    while (cluster->node_id == 0)
+    {
+        if (getentropy(&cluster->node_id, sizeof(cluster->node_id)) < 0)
+            cluster->node_id = (uint32_t)getpid() ^ (uint32_t)now_ms(CLOCK_REALTIME);
+    }
+    cluster->stats.node_id = cluster->node_id;
+    cluster->udp_fd = -1;
+
+    cluster->udp_fd = open_udp(port);
+    if (cluster->udp_fd < 0 ||
+        socketpair(AF_UNIX, SOCK_DGRAM, 0, cluster->local_fd) < 0)
+    {
+        cluster_destroy(cluster);
+        return NULL;
+    }
+
+    char *list = strdup(peers ? peers : "");
+    for (char *peer = strtok(list, ","); peer; peer = strtok(NULL, ","))
+    {
+        if (add_peer(cluster, peer) < 0)
+        {
+            free(list);
+            cluster_destroy(cluster);
+            return NULL;
+        }
+    }
+    free(list);
+    return cluster;
+}
+
+void cluster_destroy(Cluster *cluster)
+{
+    if (cluster->udp_fd >= 0)
+        close(cluster->udp_fd);
+    munmap(cluster, sizeof(Cluster));
+}
+
+static void report_change(Cluster *cluster, int op, const char *name)
+{
+    LocalChange change;
+    memset(&change, 0, sizeof(change));
+    change.op = op;
+    strncpy(change.name, name, MAX_NAME_LEN - 1);
+    if (send(cluster->local_fd[0], &change, sizeof(change), MSG_DONTWAIT) < 0)
+        printf("[CLUSTER] Gossip process is behind, dropped update for %s\n", name);
+}
+
+void cluster_claim(Cluster *cluster, const char *name)
+{
+    report_change(cluster, OP_CLAIM, name);
+}
+
+void cluster_release(Cluster *cluster, const char *name)
+{
+    report_change(cluster, OP_RELEASE, name);
+}
+
+int cluster_name_taken(Cluster *cluster, const char *name)
+{
+    uint64_t now = now_ms(CLOCK_MONOTONIC);
+    uint32_t i = hash_name(name) % CLUSTER_SLOTS;
+    for (int n = 0; n < CLUSTER_SLOTS; n++, i = (i + 1) % CLUSTER_SLOTS)
+    {
+        Claim *claim = &cluster->claims[i];
+        uint32_t state = __atomic_load_n(&claim->state, __ATOMIC_ACQUIRE);
+        if (state == SLOT_FREE)
+            return 0;
+        if (state == SLOT_USED && strcmp(claim->name, name) == 0)
+            return __atomic_load_n(&claim->expires, __ATOMIC_RELAXED) > now;
+    }
+    return 0;
+}
+
+void cluster_stats(Cluster *cluster, ClusterStats *out)
+{
+    *out = cluster->stats;
+}
+
+// Find the slot holding name, or the slot to put it in. Dead and expired
+// slots on the probe path are reused.
+static Claim *find_claim(Cluster *cluster, const char *name, uint64_t now)
+{
+    Claim *target = NULL;
+    uint32_t i = hash_name(name) % CLUSTER_SLOTS;
+    for (int n = 0; n < CLUSTER_SLOTS; n++, i = (i + 1) % CLUSTER_SLOTS)
+    {
+        Claim *claim = &cluster->claims[i];
+        if (claim->state == SLOT_USED && strcmp(claim->name, name) == 0)
+            return claim;
+        if (claim->state == SLOT_USED && claim->expires > now)
+            continue;
+        if (!target)
+            target = claim;
+        if (claim->state == SLOT_FREE)
+            break;
+    }
+    return target;
+}
+
+static LocalClaim *find_local(const char *name)
+{
+    for (int i = 0; i < local_count; i++)
+    {
+        if (strcmp(local[i].name, name) == 0)
+            return &local[i];
+    }
+    return NULL;
+}
+
+static void flush_batch(Cluster *cluster)
+{
+    int count = ntohs(batch.header.count);
+    if (count == 0)
+        return;
+
+    size_t len = sizeof(WireHeader) + count * sizeof(WireClaim);
+    for (int i = 0; i < cluster->peer_count; i++)
+    {
+        sendto(cluster->udp_fd, &batch, len, 0,
+               (struct sockaddr *)&cluster->peers[i], cluster->peer_len[i]);
+    }
+    cluster->stats.batches_sent++;
+    cluster->stats.claims_sent += count;
+    batch.header.count = 0;
+}
+
+// Add one claim or release to the outgoing batch; a full batch goes out at
+// once, otherwise within CLUSTER_FLUSH_MS
+static void queue_update(Cluster *cluster, int op, uint64_t claimed_at, const char *name)
+{
+    int count = ntohs(batch.header.count);
+    if (count == 0)
+        batch_deadline = now_ms(CLOCK_MONOTONIC) + CLUSTER_FLUSH_MS;
+
+    WireClaim *wire = &batch.claims[count];
+    memset(wire, 0, sizeof(*wire));
+    wire->op = op;
+    wire->claimed_at = htobe64(claimed_at);
+    strncpy(wire->name, name, MAX_NAME_LEN - 1);
+    batch.header.count = htons(count + 1);
+
+    if (count + 1 == CLUSTER_BATCH)
+        flush_batch(cluster);
+}
+
+static void apply_local(Cluster *cluster, const LocalChange *change)
+{
+    LocalClaim *mine = find_local(change->name);
+    if (change->op == OP_CLAIM)
+    {
+        if (mine || local_count == CLUSTER_MAX_LOCAL)
+            return;
+        mine = &local[local_count++];
+        mine->claimed_at = now_ms(CLOCK_REALTIME);
+        mine->lost = 0;
+        memcpy(mine->name, change->name, MAX_NAME_LEN);
+        queue_update(cluster, OP_CLAIM, mine->claimed_at, mine->name);
+    }
+    else if (mine)
+    {
+        queue_update(cluster, OP_RELEASE, mine->claimed_at, mine->name);
+        *mine = local[--local_count];
+    }
+}
+
+// Whether claim a (at, node) beats claim b
+static int claim_wins(uint64_t a_at, uint32_t a_node, uint64_t b_at, uint32_t b_node)
+{
+    return a_at < b_at || (a_at == b_at && a_node < b_node);
+}
+
+static void apply_remote(Cluster *cluster, uint32_t node, const WireClaim *wire, pid_t notify)
+{
+    char name[MAX_NAME_LEN];
+    memcpy(name, wire->name, MAX_NAME_LEN);
+    name[MAX_NAME_LEN - 1] = '\0';
+    uint64_t claimed_at = be64toh(wire->claimed_at);
+    uint64_t now = now_ms(CLOCK_MONOTONIC);
+    Claim *claim = find_claim(cluster, name, now);
+
+    if (wire->op == OP_RELEASE)
+    {
+        if (claim && claim->state == SLOT_USED && claim->node == node &&
+            strcmp(claim->name, name) == 0)
+        {
+            __atomic_store_n(&claim->state, SLOT_DEAD, __ATOMIC_RELEASE);
+        }
+        return;
+    }
+
+    cluster->stats.claims_received++;
+    LocalClaim *mine = find_local(name);
+    if (mine && !mine->lost)
+    {
+        if (claim_wins(mine->claimed_at, cluster->node_id, claimed_at, node))
+        {
+            // Ours stands; repeat it now rather than at the next renewal
+            cluster->stats.conflicts_won++;
+            printf("[CLUSTER] Kept %s against node %08x\n", name, node);
+            queue_update(cluster, OP_CLAIM, mine->claimed_at, mine->name);
+            return;
+        }
+        cluster->stats.conflicts_lost++;
+        mine->lost = 1;
+        printf("[CLUSTER] Lost %s to node %08x\n", name, node);
+        kill(notify, SIGUSR2);
+    }
+
+    if (!claim)
+        return;   // registry full
+    if (claim->state == SLOT_USED && strcmp(claim->name, name) == 0 && claim->expires > now)
+    {
+        if (claim->node == node)
+        {
+            __atomic_store_n(&claim->expires, now + CLUSTER_LEASE_MS, __ATOMIC_RELAXED);
+            return;
+        }
+        if (!claim_wins(claimed_at, node, claim->claimed_at, claim->node))
+            return;   // an earlier claim from a third node stands
+    }
+
+    // Take the slot out of service while it is rewritten
+    __atomic_store_n(&claim->state, SLOT_DEAD, __ATOMIC_RELEASE);
+    claim->node = node;
+    claim->claimed_at = claimed_at;
+    claim->expires = now + CLUSTER_LEASE_MS;
+    memcpy(claim->name, name, MAX_NAME_LEN);
+    __atomic_store_n(&claim->state, SLOT_USED, __ATOMIC_RELEASE);
+}
+
+static void receive_batch(Cluster *cluster, pid_t notify)
+{
+    struct {
+        WireHeader header;
+        WireClaim claims[CLUSTER_BATCH];
+    } in;
+
+    ssize_t len = recv(cluster->udp_fd, &in, sizeof(in), MSG_DONTWAIT);
+    if (len < (ssize_t)sizeof(WireHeader) || ntohl(in.header.magic) != CLUSTER_MAGIC)
+        return;
+
+    uint32_t node = ntohl(in.header.node);
+    int count = ntohs(in.header.count);
+    if (node == cluster->node_id || count > CLUSTER_BATCH ||
+        len < (ssize_t)(sizeof(WireHeader) + count * sizeof(WireClaim)))
+        return;
+
+    for (int i = 0; i < count; i++)
+        apply_remote(cluster, node, &in.claims[i], notify);
+}
+
+// Retire remote claims whose lease ran out, and count the live ones
+static void sweep_expired(Cluster *cluster)
+{
+    uint64_t now = now_ms(CLOCK_MONOTONIC);
+    uint32_t live = 0;
+    for (int i = 0; i < CLUSTER_SLOTS; i++)
+    {
+        Claim *claim = &cluster->claims[i];
+        if (claim->state != SLOT_USED)
+            continue;
+        if (claim->expires <= now)
+            __atomic_store_n(&claim->state, SLOT_DEAD, __ATOMIC_RELEASE);
+        else
+            live++;
+    }
+    cluster->stats.remote_names = live;
+}
+
+static void gossip_loop(Cluster *cluster, pid_t notify)
+{
+    batch.header.magic = htonl(CLUSTER_MAGIC);
+    batch.header.node = htonl(cluster->node_id);
+    batch.header.count = 0;
+
+    uint64_t next_renew = now_ms(CLOCK_MONOTONIC) + CLUSTER_RENEW_MS;
+    struct pollfd pfds[2];
+    pfds[0].fd = cluster->udp_fd;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = cluster->local_fd[1];
+    pfds[1].events = POLLIN;
+
+    for (;;)
+    {
+        uint64_t now = now_ms(CLOCK_MONOTONIC);
+        uint64_t wake = next_renew;
+        if (batch.header.count && batch_deadline < wake)
+            wake = batch_deadline;
+        int timeout = wake > now ? (int)(wake - now) : 0;
+
+        if (poll(pfds, 2, timeout) < 0 && errno != EINTR)
+        {
+            perror("[CLUSTER] poll");
+            return;
+        }
+
+        if (pfds[1].revents & (POLLIN | POLLHUP))
+        {
+            LocalChange change;
+            ssize_t len = recv(cluster->local_fd[1], &change, sizeof(change), MSG_DONTWAIT);
+            if (len == 0)
+                return;   // parent gone
+            if (len == sizeof(change))
+            {
+                change.name[MAX_NAME_LEN - 1] = '\0';
+                apply_local(cluster, &change);
+            }
+        }
+        if (pfds[0].revents & POLLIN)
+            receive_batch(cluster, notify);
+
+        now = now_ms(CLOCK_MONOTONIC);
+        if (now >= next_renew)
+        {
+            // Renew every lease we still hold, in as few datagrams as possible
+            for (int i = 0; i < local_count; i++)
+            {
+                if (!local[i].lost)
+                    queue_update(cluster, OP_CLAIM, local[i].claimed_at, local[i].name);
+            }
+            flush_batch(cluster);
+            sweep_expired(cluster);
+            next_renew = now + CLUSTER_RENEW_MS;
+        }
+        else if (batch.header.count && now >= batch_deadline)
+        {
+            flush_batch(cluster);
+        }
+    }
+}
+
+pid_t cluster_start(Cluster *cluster, pid_t notify)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid != 0)
+    {
+        if (pid < 0)
+            perror("fork failed");
+        close(cluster->local_fd[1]);
+        return pid;
+    }
+
+#ifdef __linux__
+    prctl(PR_SET_PDEATHSIG, SIGTERM);  // go away with the server
+#endif
+    signal(SIGUSR1, SIG_IGN);
+    signal(SIGUSR2, SIG_IGN);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    close(cluster->local_fd[0]);
+    gossip_loop(cluster, notify);
+    exit(1);
+}
@@ -0,0 +1,47 @@
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// Cluster-wide duplicate-name registry. Each node announces the names its
+// players hold to its peers over UDP, in batches. A claim is a lease: the
+// owner renews it, and peers forget it once it lapses. When two nodes claim
+// the same name, the earlier claim wins (ties go to the lower node id).
+
+#define CLUSTER_LEASE_MS 3000
+#define CLUSTER_RENEW_MS 1000
+#define CLUSTER_FLUSH_MS 20           // longest a claim waits to be batched
+#define CLUSTER_MAX_PEERS 16
+
+typedef struct Cluster Cluster;
+
+typedef struct {
+    uint32_t node_id;
+    uint32_t remote_names;            // live claims held by other nodes
+    uint64_t batches_sent;
+    uint64_t claims_sent;
+    uint64_t claims_received;
+    uint64_t conflicts_won;
+    uint64_t conflicts_lost;
+} ClusterStats;
+
+// Bind the gossip socket on port and resolve the comma-separated host:port
+// peer list
+Cluster *cluster_create(const char *port, const char *peers);
+void cluster_destroy(Cluster *cluster);
+
+// Fork the gossip process. It signals notify with SIGUSR2 whenever a local
+// name loses a conflict. Returns its pid, or -1.
+pid_t cluster_start(Cluster *cluster, pid_t notify);
+
+// Announce that a local player took or gave up a name (parent only)
+void cluster_claim(Cluster *cluster, const char *name);
+void cluster_release(Cluster *cluster, const char *name);
+
+// Whether another node holds a live claim on name. Any process may ask.
+int cluster_name_taken(Cluster *cluster, const char *name);
+
+void cluster_stats(Cluster *cluster, ClusterStats *out);
+
+#endif
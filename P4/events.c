@@ -0,0 +1,103 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "events.h"
+
+// Bounded multi-producer, single-consumer ring in shared memory. Each cell
+// carries a sequence number that says whose turn it is: producers claim a
+// cell by CAS on the tail, fill it, then publish by bumping its sequence;
+// the consumer frees it again by advancing the sequence a full lap. No
+// locks are taken, so pushing is safe from a signal handler. A producer
+// that dies between claiming and publishing a cell would stall the
+// consumer at that cell; the claim and publish are a few instructions apart.
+typedef struct {
+    uint64_t seq;
+    GameEvent event;
+} Cell;
+
+struct EventRing {
+    size_t map_len;
+    uint32_t mask;
+    uint64_t tail __attribute__((aligned(64)));     // next cell to claim
+    uint64_t head __attribute__((aligned(64)));     // next cell to consume
+    Cell cells[] __attribute__((aligned(64)));
+};
+
+// Map a ring of capacity cells (rounded up to a power of two)
+EventRing *events_create(uint32_t capacity)
+{
+    uint32_t size = 1;
+    while (size < capacity)
+        size <<= 1;
+
+    size_t len = sizeof(EventRing) + size * sizeof(Cell);
+    EventRing *ring = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED)
+    {
+        perror("events mmap failed");
+        return NULL;
+    }
+
+    ring->map_len = len;
+    ring->mask = size - 1;
+    for (uint32_t i = 0; i < size; i++)
+        ring->cells[i].seq = i;
+    return ring;
+}
+
+void events_destroy(EventRing *ring)
+{
+    if (ring)
+        munmap(ring, ring->map_len);
+}
+
+// Add an event. Returns -1 if the ring is full.
+int events_push(EventRing *ring, const GameEvent *event)
+{
+    uint64_t pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    for (;;)
+    {
+        Cell *cell = &ring->cells[pos & ring->mask];
+        uint64_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)(seq - pos);
+
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&ring->tail, &pos, pos + 1, 0,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                cell->event = *event;
+                __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+                return 0;
+            }
+            // pos was reloaded by the failed CAS
+        }
+        else if (diff < 0)
+        {
+            return -1;
+        }
+        else
+        {
+            pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Take the oldest published event. Only the parent calls this. Returns -1
+// when nothing is ready.
+int events_pop(EventRing *ring, GameEvent *event)
+{
+    uint64_t pos = ring->head;
+    Cell *cell = &ring->cells[pos & ring->mask];
+    uint64_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+
+    if (seq != pos + 1)
+        return -1;
+
+    *event = cell->event;
+    ring->head = pos + 1;
+    __atomic_store_n(&cell->seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+    return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdint.h>
+
+// Game lifecycle events, pushed by game processes, the hub (and the
+// SIGCHLD handler) and drained by the parent
+enum {
+    EVENT_GAME_STARTED = 1,
+    EVENT_GAME_FINISHED,
+    EVENT_CHILD_EXITED,
+    EVENT_MUX_FINISHED,           // a hub game ended; game is the hub's index
+    EVENT_MUX_CLAIM,              // the hub asks for names[0] for seat game
+    EVENT_MUX_RELEASE,            // the hub gives back a claimed name
+};
+
+#define EVENT_NAME_LEN 73         // MAX_NAME_LEN
+
+typedef struct {
+    uint8_t type;
+    uint8_t winner;               // 1 or 2, 0 if the game ended without one
+    uint8_t forfeit;
+    uint8_t moves;
+    int32_t pid;
+    uint32_t game;                // game_pool index
+    int32_t status;               // waitpid() status for EVENT_CHILD_EXITED
+    uint32_t duration_ms;
+    uint32_t rtt_us[2];           // mean sampled RTT per player, finished games
+    uint32_t retrans[2];          // retransmitted segments per player
+    uint32_t claim;               // hub claim id, for claims and releases
+    char names[2][EVENT_NAME_LEN];  // players of a hub game, which the parent
+                                    // has no Game for
+} GameEvent;
+
+typedef struct EventRing EventRing;
+
+EventRing *events_create(uint32_t capacity);
+void events_destroy(EventRing *ring);
+int events_push(EventRing *ring, const GameEvent *event);
+int events_pop(EventRing *ring, GameEvent *event);
+
+#endif
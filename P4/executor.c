@@ -0,0 +1,305 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "executor.h"
+
+typedef struct {
+    void (*run)(void *);
+    void (*done)(void *);
+    void *arg;
+    uint64_t submitted;
+    uint64_t started;
+    uint64_t finished;
+} ExecTask;
+
+// One worker's queue. The owner takes the newest task from the tail, while
+// thieves take the oldest from the head. Kept on its own cache lines, since
+// the submitter and thieves touch it from other cores.
+typedef struct {
+    pthread_mutex_t lock;
+    uint32_t head;                // free-running; index with % EXEC_DEQUE_SIZE
+    uint32_t tail;
+    ExecTask tasks[EXEC_DEQUE_SIZE];
+} __attribute__((aligned(64))) Deque;
+
+typedef struct {
+    Executor *ex;
+    int id;
+    pthread_t thread;
+    Deque deque;
+} Worker;
+
+struct Executor {
+    int workers;
+    uint32_t next;                // round-robin submit target
+    uint32_t in_flight;           // submitted but not completed (loop only)
+    uint32_t capacity;
+    ExecutorStats *stats;
+    ExecutorStats own_stats;      // used when the caller gave none
+
+    // Sleeping workers wait here until a task is queued
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+    uint32_t queued;              // tasks sitting in deques
+    int stopping;
+
+    // Finished tasks waiting for executor_complete(); never more than
+    // capacity, since in_flight is capped at submit
+    pthread_mutex_t done_lock;
+    uint64_t done_head;
+    uint64_t done_tail;
+    ExecTask *done_ring;
+    int wake_fds[2];              // pipe; a byte means completions are waiting
+
+    Worker worker[EXEC_MAX_WORKERS];
+};
+
+static int deque_push(Deque *dq, const ExecTask *task)
+{
+    int pushed = 0;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail - dq->head < EXEC_DEQUE_SIZE)
+    {
+        dq->tasks[dq->tail++ % EXEC_DEQUE_SIZE] = *task;
+        pushed = 1;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return pushed;
+}
+
+static int deque_pop(Deque *dq, ExecTask *task)
+{
+    int popped = 0;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail != dq->head)
+    {
+        *task = dq->tasks[--dq->tail % EXEC_DEQUE_SIZE];
+        popped = 1;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return popped;
+}
+
+static int deque_steal(Deque *dq, ExecTask *task)
+{
+    int stolen = 0;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->tail != dq->head)
+    {
+        *task = dq->tasks[dq->head++ % EXEC_DEQUE_SIZE];
+        stolen = 1;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return stolen;
+}
+
+// Take a task from the worker's own deque, or steal one, starting with the
+// next worker along so thieves spread out
+static int find_task(Worker *w, ExecTask *task)
+{
+    Executor *ex = w->ex;
+    if (deque_pop(&w->deque, task))
+        return 1;
+    for (int i = 1; i < ex->workers; i++)
+    {
+        if (deque_steal(&ex->worker[(w->id + i) % ex->workers].deque, task))
+        {
+            __atomic_fetch_add(&ex->stats->steals, 1, __ATOMIC_RELAXED);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void post_completion(Executor *ex, const ExecTask *task)
+{
+    pthread_mutex_lock(&ex->done_lock);
+    int was_empty = ex->done_head == ex->done_tail;
+    ex->done_ring[ex->done_tail++ % ex->capacity] = *task;
+    pthread_mutex_unlock(&ex->done_lock);
+
+    if (was_empty)
+    {
+        char byte = 1;
+        while (write(ex->wake_fds[1], &byte, 1) < 0 && errno == EINTR)
+            ;
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    Worker *w = arg;
+    Executor *ex = w->ex;
+    ExecTask task;
+
+    for (;;)
+    {
+        if (find_task(w, &task))
+        {
+            __atomic_fetch_sub(&ex->queued, 1, __ATOMIC_RELAXED);
+            task.started = trace_now();
+            task.run(task.arg);
+            task.finished = trace_now();
+            post_completion(ex, &task);
+            continue;
+        }
+
+        // Tasks are only counted in queued under idle_lock, so a submit
+        // cannot slip in between this check and the wait
+        pthread_mutex_lock(&ex->idle_lock);
+        while (__atomic_load_n(&ex->queued, __ATOMIC_RELAXED) == 0 && !ex->stopping)
+            pthread_cond_wait(&ex->idle_cond, &ex->idle_lock);
+        int stop = ex->stopping && __atomic_load_n(&ex->queued, __ATOMIC_RELAXED) == 0;
+        pthread_mutex_unlock(&ex->idle_lock);
+        if (stop)
+            return NULL;
+    }
+}
+
+Executor *executor_create(int workers, ExecutorStats *stats)
+{
+    if (workers < 1 || workers > EXEC_MAX_WORKERS)
+    {
+        fprintf(stderr, "executor: workers must be 1 to %d\n", EXEC_MAX_WORKERS);
+        return NULL;
+    }
+
+    // Aligned so each deque really does start its own cache line
+    Executor *ex;
+    if (posix_memalign((void **)&ex, 64, sizeof(Executor)) != 0)
+        return NULL;
+    memset(ex, 0, sizeof(Executor));
+    ex->workers = workers;
+    ex->capacity = workers * EXEC_DEQUE_SIZE;
+    ex->stats = stats ? stats : &ex->own_stats;
+    memset(ex->stats, 0, sizeof(ExecutorStats));
+    ex->stats->workers = workers;
+    hist_clear(&ex->stats->queue_delay);
+    hist_clear(&ex->stats->run_time);
+    ex->done_ring = calloc(ex->capacity, sizeof(ExecTask));
+    if (!ex->done_ring || pipe(ex->wake_fds) < 0)
+    {
+        perror("executor");
+        free(ex->done_ring);
+        free(ex);
+        return NULL;
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        fcntl(ex->wake_fds[i], F_SETFL, fcntl(ex->wake_fds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(ex->wake_fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    pthread_mutex_init(&ex->idle_lock, NULL);
+    pthread_cond_init(&ex->idle_cond, NULL);
+    pthread_mutex_init(&ex->done_lock, NULL);
+
+    for (int i = 0; i < workers; i++)
+    {
+        Worker *w = &ex->worker[i];
+        w->ex = ex;
+        w->id = i;
+        pthread_mutex_init(&w->deque.lock, NULL);
+    }
+    for (int i = 0; i < workers; i++)
+    {
+        int err = pthread_create(&ex->worker[i].thread, NULL, worker_main, &ex->worker[i]);
+        if (err)
+        {
+            fprintf(stderr, "executor: pthread_create: %s\n", strerror(err));
+            ex->workers = i;
+            executor_destroy(ex);
+            return NULL;
+        }
+    }
+    return ex;
+}
+
+void executor_destroy(Executor *ex)
+{
+    if (!ex)
+        return;
+
+    pthread_mutex_lock(&ex->idle_lock);
+    ex->stopping = 1;
+    pthread_cond_broadcast(&ex->idle_cond);
+    pthread_mutex_unlock(&ex->idle_lock);
+    for (int i = 0; i < ex->workers; i++)
+        pthread_join(ex->worker[i].thread, NULL);
+    executor_complete(ex);
+
+    for (int i = 0; i < ex->workers; i++)
+        pthread_mutex_destroy(&ex->worker[i].deque.lock);
+    pthread_mutex_destroy(&ex->idle_lock);
+    pthread_cond_destroy(&ex->idle_cond);
+    pthread_mutex_destroy(&ex->done_lock);
+    close(ex->wake_fds[0]);
+    close(ex->wake_fds[1]);
+    free(ex->done_ring);
+    free(ex);
+}
+
+int executor_submit(Executor *ex, void (*run)(void *), void (*done)(void *), void *arg)
+{
+    ExecTask task = { run, done, arg, trace_now(), 0, 0 };
+
+    // Spread tasks round robin; if that deque is full, try the others
+    int pushed = 0;
+    if (ex->in_flight < ex->capacity)
+    {
+        uint32_t first = ex->next++;
+        for (int i = 0; i < ex->workers && !pushed; i++)
+            pushed = deque_push(&ex->worker[(first + i) % ex->workers].deque, &task);
+    }
+    if (!pushed)
+    {
+        __atomic_fetch_add(&ex->stats->rejected, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    ex->in_flight++;
+    __atomic_fetch_add(&ex->stats->submitted, 1, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&ex->idle_lock);
+    __atomic_fetch_add(&ex->queued, 1, __ATOMIC_RELAXED);
+    pthread_cond_signal(&ex->idle_cond);
+    pthread_mutex_unlock(&ex->idle_lock);
+    return 0;
+}
+
+int executor_fd(Executor *ex)
+{
+    return ex->wake_fds[0];
+}
+
+int executor_complete(Executor *ex)
+{
+    char drain[64];
+    while (read(ex->wake_fds[0], drain, sizeof(drain)) > 0)
+        ;
+
+    int ran = 0;
+    for (;;)
+    {
+        ExecTask task;
+        pthread_mutex_lock(&ex->done_lock);
+        int empty = ex->done_head == ex->done_tail;
+        if (!empty)
+            task = ex->done_ring[ex->done_head++ % ex->capacity];
+        pthread_mutex_unlock(&ex->done_lock);
+        if (empty)
+            break;
+
+        hist_record(&ex->stats->queue_delay, task.started - task.submitted);
+        hist_record(&ex->stats->run_time, task.finished - task.started);
+        __atomic_fetch_add(&ex->stats->completed, 1, __ATOMIC_RELAXED);
+        ex->in_flight--;
+        if (task.done)
+            task.done(task.arg);
+        ran++;
+    }
+    return ran;
+}
@@ -0,0 +1,47 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <stdint.h>
+#include "trace.h"
+
+// Work-stealing thread pool for CPU or disk work that must stay off an I/O
+// loop. The loop submits tasks; each worker runs tasks from its own bounded
+// deque and steals the oldest task of another worker when its own is empty.
+// A finished task's done callback runs back on the loop, in
+// executor_complete(), once the descriptor from executor_fd() is readable.
+
+#define EXEC_MAX_WORKERS 16
+#define EXEC_DEQUE_SIZE 256           // queued tasks per worker
+
+// Counters may live in shared memory, so another process can print them.
+// The histograms have a single writer, the thread calling
+// executor_complete().
+typedef struct {
+    uint32_t workers;
+    uint64_t submitted;
+    uint64_t completed;
+    uint64_t rejected;                // queues full; the caller ran it inline
+    uint64_t steals;
+    Histogram queue_delay;            // submit to start of run
+    Histogram run_time;
+} ExecutorStats;
+
+typedef struct Executor Executor;
+
+// Start workers threads. stats may be NULL.
+Executor *executor_create(int workers, ExecutorStats *stats);
+
+// Finish every queued task, run the remaining done callbacks and stop
+void executor_destroy(Executor *ex);
+
+// Queue run(arg) on a worker; done(arg) follows on the submitting thread.
+// Returns -1 if every queue is full.
+int executor_submit(Executor *ex, void (*run)(void *), void (*done)(void *), void *arg);
+
+// Readable while completions are waiting
+int executor_fd(Executor *ex);
+
+// Run the done callbacks of finished tasks. Returns how many ran.
+int executor_complete(Executor *ex);
+
+#endif
@@ -171,7 +171,7 @@ sleep 0.5
 sleep 2
 
 # Try to connect another Alice (should be rejected)
-timeout 3 ./testc localhost $PORT Alice > test3_alice2.log 2>&1
+(sleep 2) | timeout 3 ./testc localhost $PORT Alice > test3_alice2.log 2>&1
 
 if grep -q "22 Already Playing" test3_alice2.log; then
     print_pass "Duplicate player rejected with error code 22"
@@ -286,7 +286,7 @@ SERVER_PID=$!
 sleep 1
 
 LONG_NAME="ThisIsAnExtremelyLongPlayerNameThatExceedsTheSeventyTwoCharacterLimitImposedByTheNimGameProtocol"
-timeout 3 ./testc localhost $PORT "$LONG_NAME" > test7_long.log 2>&1
+(sleep 2) | timeout 3 ./testc localhost $PORT "$LONG_NAME" > test7_long.log 2>&1
 
 if grep -q "21 Long Name" test7_long.log; then
     print_pass "Long name rejected (error 21)"
@@ -295,6 +295,334 @@ fi
 kill -9 $SERVER_PID 2>/dev/null
 wait 2>/dev/null
 
+#############################################################################
+print_header "TEST 8: Cluster Mode - Duplicate Names Across Nodes"
+#############################################################################
+
+PORT=6008
+PORT_B=6009
+echo "Testing a two-node cluster on ports $PORT and $PORT_B..."
+./nimd_concurrent -C 6108 -P 127.0.0.1:6109 $PORT > test8_node_a.log 2>&1 &
+NODE_A_PID=$!
+./nimd_concurrent -C 6109 -P 127.0.0.1:6108 $PORT_B > test8_node_b.log 2>&1 &
+NODE_B_PID=$!
+sleep 1
+
+# Alice plays on node A
+(sleep 10) | timeout 12 ./testc localhost $PORT Alice > test8_alice1.log 2>&1 &
+sleep 0.5
+(sleep 10) | timeout 12 ./testc localhost $PORT Bob > test8_bob.log 2>&1 &
+sleep 1
+
+# Another Alice on node B should be rejected
+(sleep 2) | timeout 3 ./testc localhost $PORT_B Alice > test8_alice2.log 2>&1
+
+if grep -q "22 Already Playing" test8_alice2.log; then
+    print_pass "Duplicate player rejected by another node"
+else
+    print_fail "Duplicate player not rejected across nodes"
+fi
+
+# Once node A is gone, its lease lapses and node B lets Alice in
+kill -9 $NODE_A_PID 2>/dev/null
+sleep 4
+# (a waiting testc is killed before it flushes, so talk to the node directly)
+exec 3<>/dev/tcp/127.0.0.1/$PORT_B
+printf '0|11|OPEN|Alice|' >&3
+timeout 2 head -c 10 <&3 > test8_alice3.log 2>&1
+exec 3<&-
+
+if grep -q "WAIT" test8_alice3.log; then
+    print_pass "Name freed after the owning node's lease expired"
+else
+    print_fail "Name still held after the owning node died"
+fi
+
+kill -9 $NODE_B_PID 2>/dev/null
+pkill -9 -f testc 2>/dev/null
+wait 2>/dev/null
+
+# Hub seats are announced too: node A serves version 1 clients in its hub
+PORT=6018
+PORT_B=6019
+echo "Testing a hub node and a classic node on ports $PORT and $PORT_B..."
+./nimd_concurrent -m -C 6118 -P 127.0.0.1:6119 $PORT > test8_hub_node_a.log 2>&1 &
+NODE_A_PID=$!
+./nimd_concurrent -C 6119 -P 127.0.0.1:6118 $PORT_B > test8_hub_node_b.log 2>&1 &
+NODE_B_PID=$!
+sleep 1
+
+# A version 1 Alice on node A keeps a version 0 Alice out of node B
+exec 3<>/dev/tcp/127.0.0.1/$PORT
+printf '1|13|OPEN|7|Alice|' >&3
+sleep 1
+(sleep 2) | timeout 3 ./testc localhost $PORT_B Alice > test8_hub_alice.log 2>&1
+
+# and a classic game on node B keeps Carol out of node A's hub
+(sleep 6) | timeout 7 ./testc localhost $PORT_B Carol > /dev/null 2>&1 &
+sleep 0.5
+(sleep 6) | timeout 7 ./testc localhost $PORT_B Dave > /dev/null 2>&1 &
+sleep 1
+printf '1|13|OPEN|8|Carol|' >&3
+timeout 1 cat <&3 > test8_hub_v1.log 2>&1
+exec 3<&-
+
+if grep -q "22 Already Playing" test8_hub_alice.log && grep -q "WAIT|7|" test8_hub_v1.log && \
+   grep -q "FAIL|8|22 Already Playing" test8_hub_v1.log; then
+    print_pass "Hub and classic players share names across nodes"
+else
+    print_fail "Hub names not shared across nodes"
+fi
+
+kill -9 $NODE_A_PID $NODE_B_PID 2>/dev/null
+pkill -9 -f testc 2>/dev/null
+wait 2>/dev/null
+
+#############################################################################
+print_header "TEST 9: Flood Protection"
+#############################################################################
+
+PORT=6010
+echo "Testing the per-player message budget on port $PORT..."
+./nimd_concurrent $PORT > test9_server.log 2>&1 &
+FLOOD_SERVER_PID=$!
+sleep 1
+
+# Two raw players; Player 1 keeps sending a move that is too big
+exec 3<>/dev/tcp/127.0.0.1/$PORT
+printf '0|11|OPEN|Flood|' >&3
+sleep 0.3
+exec 4<>/dev/tcp/127.0.0.1/$PORT
+printf '0|10|OPEN|Calm|' >&4
+sleep 0.3
+timeout 3 cat <&3 > test9_flood.log 2>&1 &
+FLOOD_READER_PID=$!
+trap '' PIPE
+for i in $(seq 1 50); do
+    printf '0|09|MOVE|0|5|' >&3 2>/dev/null || break
+    sleep 0.01
+done
+trap - PIPE
+timeout 1 cat <&4 > test9_calm.log 2>&1
+wait $FLOOD_READER_PID
+exec 3<&- 4<&-
+
+if grep -q "34 Flooding" test9_flood.log && grep -q "Forfeit" test9_calm.log; then
+    print_pass "Flooding player cut off and forfeited"
+else
+    print_fail "Flooding player not cut off"
+fi
+
+if [ "$(grep -o "PLAY" test9_calm.log | wc -l)" -eq 1 ]; then
+    print_pass "Rejected moves do not re-send PLAY"
+else
+    print_fail "PLAY re-sent after rejected moves"
+fi
+
+kill -9 $FLOOD_SERVER_PID 2>/dev/null
+wait 2>/dev/null
+
+#############################################################################
+print_header "TEST 10: Unix Socket Listener"
+#############################################################################
+
+SOCK=/tmp/nimd_test10.sock
+echo "Testing a game over the Unix socket $SOCK..."
+./nimd_concurrent -U $SOCK > test10_server.log 2>&1 &
+UNIX_SERVER_PID=$!
+sleep 1
+
+(sleep 1; echo "4 9") | timeout 5 ./testc $SOCK Alice > test10_alice.log 2>&1 &
+sleep 0.5
+(sleep 2) | timeout 5 ./testc $SOCK Bob > test10_bob.log 2>&1 &
+sleep 3
+
+if grep -q "opponent: Alice" test10_bob.log && grep -q "Board: 1 3 5 7 0" test10_bob.log; then
+    print_pass "Game played over the Unix socket"
+else
+    print_fail "Game over the Unix socket did not work"
+fi
+
+# A second server must not take over a socket that is still answering,
+# or delete a file that is not a socket at all
+timeout 2 ./nimd_concurrent -U $SOCK > test10_second.log 2>&1
+NOT_SOCK=/tmp/nimd_test10.file
+echo "keep me" > $NOT_SOCK
+timeout 2 ./nimd_concurrent -U $NOT_SOCK > test10_file.log 2>&1
+if grep -q "Address already in use" test10_second.log && [ -S $SOCK ] &&
+   grep -q "Address already in use" test10_file.log && grep -q "keep me" $NOT_SOCK; then
+    print_pass "Live socket and plain file left alone"
+else
+    print_fail "Listener replaced a path it did not own"
+fi
+rm -f $NOT_SOCK
+
+kill -9 $UNIX_SERVER_PID 2>/dev/null
+pkill -9 -f testc 2>/dev/null
+wait 2>/dev/null
+
+# The dead server's socket file is stale and is replaced
+./nimd_concurrent -U $SOCK > test10_restart.log 2>&1 &
+UNIX_SERVER_PID=$!
+sleep 1
+if kill -0 $UNIX_SERVER_PID 2>/dev/null; then
+    print_pass "Stale socket from a dead server replaced"
+else
+    print_fail "Stale socket not replaced"
+fi
+kill -9 $UNIX_SERVER_PID 2>/dev/null
+wait 2>/dev/null
+rm -f $SOCK
+
+#############################################################################
+print_header "TEST 11: Live Game Table"
+#############################################################################
+
+PORT=6011
+LIVE=/tmp/nimd_test11.live
+echo "Watching a stalled game with nimtop on port $PORT..."
+./nimd_concurrent -L $LIVE $PORT > test11_server.log 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+(sleep 1; echo "4 9"; sleep 5) | timeout 7 ./testc localhost $PORT Alice > /dev/null 2>&1 &
+sleep 0.5
+(sleep 6) | timeout 7 ./testc localhost $PORT Bob > /dev/null 2>&1 &
+sleep 3
+
+./nimtop -n 1 -s 1 $LIVE > test11_nimtop.log 2>&1
+if grep -q "1 live, 1 stuck" test11_nimtop.log && \
+   grep "Alice" test11_nimtop.log | grep "Bob" | grep -q "1 3 5 7 0"; then
+    print_pass "nimtop shows the stalled game"
+else
+    print_fail "nimtop did not show the game"
+fi
+
+# -L must not clobber a running server's table or a file that is not one
+NOT_LIVE=/tmp/nimd_test11.file
+echo "keep me" > $NOT_LIVE
+timeout 2 ./nimd_concurrent -L $LIVE 6111 > test11_second.log 2>&1
+timeout 2 ./nimd_concurrent -L $NOT_LIVE 6111 > test11_file.log 2>&1
+if grep -q "in use by server" test11_second.log && grep -q "not a live game table" test11_file.log && \
+   grep -q "keep me" $NOT_LIVE && ./nimtop -n 1 $LIVE 2>&1 | grep -q "server $SERVER_PID"; then
+    print_pass "Live table path of a running server and other files left alone"
+else
+    print_fail "Live table replaced a file it did not own"
+fi
+rm -f $NOT_LIVE
+
+kill -9 $SERVER_PID 2>/dev/null
+pkill -9 -f testc 2>/dev/null
+wait 2>/dev/null
+
+# The dead server's table is stale and is taken over
+./nimd_concurrent -L $LIVE 6112 > test11_restart.log 2>&1 &
+SERVER_PID=$!
+sleep 1
+if ./nimtop -n 1 $LIVE 2>&1 | grep -q "server $SERVER_PID"; then
+    print_pass "Stale live table from a dead server replaced"
+else
+    print_fail "Stale live table not replaced"
+fi
+kill -9 $SERVER_PID 2>/dev/null
+wait 2>/dev/null
+rm -f $LIVE
+
+#############################################################################
+print_header "TEST 12: Multiplexed Hub Names"
+#############################################################################
+
+PORT=6012
+echo "Testing duplicate names between the hub and the lobby on port $PORT..."
+./nimd_concurrent -m $PORT > test12_server.log 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+# Alice takes a hub seat; a second game id and a classic client may not
+exec 3<>/dev/tcp/127.0.0.1/$PORT
+printf '1|13|OPEN|7|Alice|' >&3
+printf '1|13|OPEN|8|Alice|' >&3
+sleep 0.5
+exec 4<>/dev/tcp/127.0.0.1/$PORT
+printf '0|11|OPEN|Alice|' >&4
+timeout 1 head -c 30 <&4 > test12_classic.log 2>&1
+exec 4<&-
+
+# Carol plays a classic game; the hub may not seat her too (the clients
+# must not hold the hub connection open)
+(sleep 4) 3<&- | timeout 5 ./testc localhost $PORT Carol 3<&- > /dev/null 2>&1 &
+sleep 0.5
+(sleep 4) 3<&- | timeout 5 ./testc localhost $PORT Dave 3<&- > /dev/null 2>&1 &
+sleep 1
+printf '1|13|OPEN|9|Carol|' >&3
+timeout 1 cat <&3 > test12_hub.log 2>&1
+exec 3<&-
+
+if grep -q "WAIT|7|" test12_hub.log && grep -q "FAIL|8|22 Already Playing" test12_hub.log && \
+   grep -q "22 Already Playing" test12_classic.log && grep -q "FAIL|9|22 Already Playing" test12_hub.log; then
+    print_pass "Names are unique across the hub and the lobby"
+else
+    print_fail "Duplicate name slipped between the hub and the lobby"
+fi
+
+# One connection may hold 64 game ids; the 65th is refused on its own
+sleep 0.5
+exec 3<>/dev/tcp/127.0.0.1/$PORT
+for gid in $(seq 100 164); do
+    content="OPEN|$gid|Seat$gid|"
+    printf '1|%02d|%s' ${#content} "$content" >&3
+done
+sleep 0.5
+printf '1|13|MOVE|100|0|1|' >&3
+timeout 1 cat <&3 > test12_cap.log 2>&1
+exec 3<&-
+
+if grep -q "FAIL|164|25 Too Many Games" test12_cap.log && ! grep -q "FAIL|16[0-3]|" test12_cap.log && \
+   grep -q "PLAY|100|2|0 3 5 7 9|" test12_cap.log; then
+    print_pass "Open game ids per connection capped"
+else
+    print_fail "Open game ids per connection not capped"
+fi
+
+kill -9 $SERVER_PID 2>/dev/null
+pkill -9 -f testc 2>/dev/null
+wait 2>/dev/null
+
+#############################################################################
+print_header "TEST 13: Hub Games in the Live Table"
+#############################################################################
+
+PORT=6013
+LIVE=/tmp/nimd_test13.live
+echo "Watching a hub game with nimtop on port $PORT..."
+./nimd_concurrent -m -L $LIVE $PORT > test13_server.log 2>&1 &
+SERVER_PID=$!
+sleep 1
+
+# Erin and Finn play each other on one connection; Erin moves once
+exec 3<>/dev/tcp/127.0.0.1/$PORT
+printf '1|12|OPEN|1|Erin|' >&3
+printf '1|12|OPEN|2|Finn|' >&3
+sleep 0.5
+printf '1|11|MOVE|1|4|9|' >&3
+sleep 0.5
+./nimtop -n 1 $LIVE > test13_playing.log 2>&1
+exec 3<&-
+sleep 0.5
+./nimtop -n 1 $LIVE > test13_over.log 2>&1
+
+if grep -q "1 live" test13_playing.log && \
+   grep "Erin" test13_playing.log | grep "Finn" | grep -q "1 3 5 7 0" && \
+   grep -q "0 live" test13_over.log; then
+    print_pass "nimtop shows hub games until they end"
+else
+    print_fail "Hub game missing from the live table"
+fi
+
+kill -9 $SERVER_PID 2>/dev/null
+wait 2>/dev/null
+rm -f $LIVE
+
 #############################################################################
 print_header "FINAL RESULTS"
 #############################################################################
@@ -0,0 +1,812 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include "game.h"
+#include "network.h"
+#include "archive.h"
+
+// Fixed-size pools shared with the game processes
+Slab *game_pool;
+Slab *conn_pool;
+Slab *buffer_pool;
+
+// Game processes report to the parent through this ring; the parent owns
+// ActivePlayers and the player stats
+EventRing *game_events;
+
+// Per-message latency histograms and sampled trace events
+Tracer *tracer;
+
+// Directory of the completed-game archive, or NULL when archiving is off
+char *archive_dir = NULL;
+
+// Seconds a disconnected player has to resume; 0 forfeits immediately
+int grace_seconds = 0;
+
+// Busy-poll budget in microseconds; 0 (the default) blocks in ppoll()
+// straight away
+int busy_poll_usec = 0;
+
+WaitStats *wait_stats;
+NetStats *net_stats;
+
+// Where each game shows its state to nimtop, or NULL when that is off
+LiveTable *live_table = NULL;
+
+// Network quality of one player over the game being run
+typedef struct {
+    uint64_t next_sample;      // trace_now() time the next sample is due
+    uint32_t samples;
+    uint64_t rtt_sum_us;
+    uint32_t rtt_max_us;
+    uint32_t rttvar_max_us;
+    uint32_t unacked_max;
+    uint32_t retrans;          // retransmits on the current socket
+    uint32_t retrans_closed;   // on sockets lost before a resume
+} NetQuality;
+
+static NetQuality game_net[2];
+
+// Allocate a connection and its read buffer for a freshly accepted socket
+slab_idx conn_alloc(int fd)
+{
+    slab_idx idx = slab_alloc(conn_pool);
+    if (idx == SLAB_NONE)
+        return SLAB_NONE;
+
+    Connection *conn = slab_get(conn_pool, idx);
+    conn->buf = slab_alloc(buffer_pool);
+    if (conn->buf == SLAB_NONE)
+    {
+        slab_free(conn_pool, idx);
+        return SLAB_NONE;
+    }
+    conn->fd = fd;
+    conn->in_len = 0;
+    conn->name[0] = '\0';
+    return idx;
+}
+
+// Return a connection and its buffer to their pools (does not close the fd)
+void conn_free(slab_idx idx)
+{
+    Connection *conn = slab_get(conn_pool, idx);
+    slab_free(buffer_pool, conn->buf);
+    slab_free(conn_pool, idx);
+}
+
+Connection *conn_get(slab_idx idx)
+{
+    return slab_get(conn_pool, idx);
+}
+
+char *conn_buffer(Connection *conn)
+{
+    return slab_get(buffer_pool, conn->buf);
+}
+
+// Send a formatted NGP message
+void send_message(int fd, const char *format, ...)
+{
+    char content[1024];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(content, sizeof(content), format, args);
+    va_end(args);
+    
+    if (fd < 0)
+        return;   // player on hold
+    
+    int content_len = strlen(content);
+    char full_msg[1124];
+    snprintf(full_msg, sizeof(full_msg), "0|%02d|%s", content_len, content);
+    
+    write(fd, full_msg, strlen(full_msg));
+}
+
+// Report a game event to the parent, waiting briefly if the ring is full
+void post_event(GameEvent *event)
+{
+    event->pid = getpid();
+    for (int i = 0; i < EVENT_PUSH_RETRIES; i++)
+    {
+        if (events_push(game_events, event) == 0)
+            return;
+        usleep(1000);
+    }
+    printf("[GAME] Event ring full, dropped event %d\n", event->type);
+}
+
+// Sample a player's TCP_INFO, at most once per NET_SAMPLE_MS unless forced.
+// The schedule is checked against the vDSO clock, so most calls make no
+// syscall at all.
+static void sample_net(slab_idx game_idx, int player, int fd, int force)
+{
+    NetQuality *q = &game_net[player - 1];
+    uint64_t now = trace_now();
+    if (!force && now < q->next_sample)
+        return;
+    q->next_sample = now + NET_SAMPLE_MS * 1000000ull;
+
+    NetSample sample;
+    if (net_sample(fd, &sample) < 0)
+        return;
+    q->samples++;
+    q->rtt_sum_us += sample.rtt_us;
+    if (sample.rtt_us > q->rtt_max_us)
+        q->rtt_max_us = sample.rtt_us;
+    if (sample.rttvar_us > q->rttvar_max_us)
+        q->rttvar_max_us = sample.rttvar_us;
+    if (sample.unacked > q->unacked_max)
+        q->unacked_max = sample.unacked;
+    q->retrans = sample.total_retrans;
+
+    trace_record(tracer, game_idx, SPAN_NET_RTT, (uint64_t)sample.rtt_us * 1000);
+    trace_record(tracer, game_idx, SPAN_NET_RTTVAR, (uint64_t)sample.rttvar_us * 1000);
+    __atomic_fetch_add(&net_stats->samples, 1, __ATOMIC_RELAXED);
+}
+
+// Take a last sample of each connected player, log the game's network
+// quality and attach it to the result event
+static void finish_net(slab_idx game_idx, GameEvent *event)
+{
+    Game *game = slab_get(game_pool, game_idx);
+    uint32_t game_retrans = 0;
+    uint32_t unacked_max = 0;
+
+    for (int p = 1; p <= 2; p++)
+    {
+        NetQuality *q = &game_net[p - 1];
+        sample_net(game_idx, p, conn_get(game->players[p - 1])->fd, 1);
+        uint32_t retrans = q->retrans_closed + q->retrans;
+        uint32_t rtt_avg = q->samples ? q->rtt_sum_us / q->samples : 0;
+        if (q->samples)
+            printf("[GAME] Network P%d: rtt avg %.2f ms max %.2f ms, rttvar max %.2f ms, "
+                   "%u retransmits, %u unacked max (%u samples)\n", p, rtt_avg / 1000.0,
+                   q->rtt_max_us / 1000.0, q->rttvar_max_us / 1000.0, retrans,
+                   q->unacked_max, q->samples);
+        event->rtt_us[p - 1] = rtt_avg;
+        event->retrans[p - 1] = retrans;
+        game_retrans += retrans;
+        if (q->unacked_max > unacked_max)
+            unacked_max = q->unacked_max;
+    }
+
+    __atomic_fetch_add(&net_stats->games, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&net_stats->retrans, game_retrans, __ATOMIC_RELAXED);
+    if (game_retrans)
+        __atomic_fetch_add(&net_stats->lossy_games, 1, __ATOMIC_RELAXED);
+    uint32_t seen = __atomic_load_n(&net_stats->unacked_max, __ATOMIC_RELAXED);
+    while (unacked_max > seen &&
+           !__atomic_compare_exchange_n(&net_stats->unacked_max, &seen, unacked_max, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+// Fill in the outcome of a finished game, report it to the parent and
+// append it to the archive. A winner of 0 means the game ended without one.
+static void record_result(slab_idx game_idx, GameRecord *record, const struct timespec *started,
+                          int winner, int forfeit)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    record->winner = winner;
+    record->forfeit = forfeit;
+    record->end_time = time(NULL);
+    record->duration_ms = (now.tv_sec - started->tv_sec) * 1000 +
+                          (now.tv_nsec - started->tv_nsec) / 1000000;
+
+    GameEvent event;
+    memset(&event, 0, sizeof(event));
+    event.type = EVENT_GAME_FINISHED;
+    event.game = game_idx;
+    event.winner = winner;
+    event.forfeit = forfeit;
+    event.moves = record->move_count;
+    event.duration_ms = record->duration_ms;
+    finish_net(game_idx, &event);
+    post_event(&event);
+    if (live_table)
+        live_clear(live_table, game_idx);
+
+    if (!archive_dir)
+        return;
+
+    if (archive_append(archive_dir, record) < 0)
+        printf("[GAME] Failed to archive game %s vs %s\n", record->p1, record->p2);
+}
+
+// Prepare a player socket for the game process: stamp arriving data so the
+// wakeup latency can be measured, and in busy-poll mode let the kernel poll
+// the device queue too. Raising SO_BUSY_POLL above net.core.busy_read needs
+// CAP_NET_ADMIN, so a failure there just leaves it off.
+// On TCP, Nagle is turned off: NAME and PLAY go out back to back, and the
+// second would otherwise wait for the client's delayed ACK. Unix sockets
+// have neither, and refuse the option harmlessly.
+static void setup_game_socket(int fd)
+{
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    if (busy_poll_usec > 0)
+        setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_usec, sizeof(busy_poll_usec));
+}
+
+// Read from a player socket and record how long the data sat in the kernel
+// before this process got to it
+static int read_stamped(int fd, char *buffer, int size, slab_idx game_idx)
+{
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(struct timespec))];
+    } control;
+    struct iovec iov = { buffer, size };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    int bytes = recvmsg(fd, &msg, 0);
+    if (bytes <= 0)
+        return bytes;
+
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c))
+    {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            struct timespec arrived, now;
+            memcpy(&arrived, CMSG_DATA(c), sizeof(arrived));
+            clock_gettime(CLOCK_REALTIME, &now);
+            int64_t waited = (int64_t)(now.tv_sec - arrived.tv_sec) * 1000000000ll +
+                             (now.tv_nsec - arrived.tv_nsec);
+            if (waited >= 0)
+                trace_record(tracer, game_idx, SPAN_ARRIVE_RECV, waited);
+        }
+    }
+    return bytes;
+}
+
+// Spin on a zero-timeout poll() for up to busy_poll_usec before the caller
+// goes to sleep. Returns poll()'s result, 0 if nothing arrived in time.
+static int spin_poll(Game *game, struct pollfd *pfds, int count)
+{
+    uint64_t start = trace_now();
+    uint64_t deadline = start + (uint64_t)busy_poll_usec * 1000;
+    int result;
+    do
+    {
+        result = poll(pfds, count, 0);
+    } while (result == 0 && !__atomic_load_n(&game->evict, __ATOMIC_ACQUIRE) &&
+             trace_now() < deadline);
+
+    __atomic_fetch_add(&wait_stats->spin_ns, trace_now() - start, __ATOMIC_RELAXED);
+    __atomic_fetch_add(result ? &wait_stats->spin_hits : &wait_stats->spin_misses, 1,
+                       __ATOMIC_RELAXED);
+    return result;
+}
+
+// Send NAME to one player; with resume enabled it also carries the token
+static void send_name(Game *game, int player)
+{
+    Connection *self = conn_get(game->players[player - 1]);
+    Connection *opponent = conn_get(game->players[2 - player]);
+
+    if (grace_seconds > 0)
+        send_message(self->fd, "NAME|%d|%s|%s|", player, opponent->name, game->tokens[player - 1]);
+    else
+        send_message(self->fd, "NAME|%d|%s|", player, opponent->name);
+}
+
+// Read whatever a player has sent onto the end of their buffer. Returns 0
+// if the connection has been closed. A full buffer is left for the caller
+// to work through first.
+static int fill_buffer(Connection *conn, int fd, slab_idx game_idx)
+{
+    int space = BUFFER_SIZE - 1 - conn->in_len;
+    if (space == 0)
+        return 1;
+    int bytes = read_stamped(fd, conn_buffer(conn) + conn->in_len, space, game_idx);
+    if (bytes <= 0)
+        return 0;
+    conn->in_len += bytes;
+    return 1;
+}
+
+// Take the next complete frame out of a player's buffer, NUL-terminated.
+// Returns its length, 0 if none has fully arrived, or -1 if the buffer does
+// not start with a frame header.
+static int next_frame(Connection *conn, char *frame)
+{
+    char *buffer = conn_buffer(conn);
+    int len = frame_length(buffer, conn->in_len);
+    if (len <= 0)
+        return len;
+    memcpy(frame, buffer, len);
+    frame[len] = '\0';
+    conn->in_len -= len;
+    memmove(buffer, buffer + len, conn->in_len);
+    return len;
+}
+
+// Close whichever player sockets are still open
+static void close_players(struct pollfd *pfds)
+{
+    for (int p = 0; p < 2; p++)
+    {
+        if (pfds[p].fd >= 0)
+            close(pfds[p].fd);
+        pfds[p].fd = -1;
+    }
+}
+
+// Handle a complete game between two players
+void handle_game(slab_idx game_idx, int ctl_fd)
+{
+    Game *game = slab_get(game_pool, game_idx);
+    Connection *p1 = conn_get(game->players[0]);
+    Connection *p2 = conn_get(game->players[1]);
+    char *p1_name = p1->name;
+    char *p2_name = p2->name;
+
+    printf("[GAME] Starting game: %s vs %s\n", p1_name, p2_name);
+    setup_game_socket(p1->fd);
+    setup_game_socket(p2->fd);
+
+    GameEvent started_event;
+    memset(&started_event, 0, sizeof(started_event));
+    started_event.type = EVENT_GAME_STARTED;
+    started_event.game = game_idx;
+    post_event(&started_event);
+    
+    // Send NAME messages
+    send_name(game, 1);
+    send_name(game, 2);
+    
+    printf("[GAME] Sent NAME messages\n");
+
+    // First network sample: the handshake has already given an RTT
+    memset(game_net, 0, sizeof(game_net));
+    sample_net(game_idx, 1, p1->fd, 1);
+    sample_net(game_idx, 2, p2->fd, 1);
+    
+    // Track the move sequence for the archive
+    GameRecord record;
+    memset(&record, 0, sizeof(record));
+    strncpy(record.p1, p1_name, ARCHIVE_NAME_LEN - 1);
+    strncpy(record.p2, p2_name, ARCHIVE_NAME_LEN - 1);
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    // Initialize game board
+    int game_board[5] = {1, 3, 5, 7, 9};
+    int current_player = 1;
+    int other_player = 2;
+
+    // This game's entry in the live table, republished each time round
+    // the loop. Only memory is written, so watching costs the game nothing.
+    LiveGame live;
+    memset(&live, 0, sizeof(live));
+    live.state = LIVE_PLAYING;
+    live.pid = getpid();
+    strncpy(live.names[0], p1_name, LIVE_NAME_LEN - 1);
+    strncpy(live.names[1], p2_name, LIVE_NAME_LEN - 1);
+    live.started = live.last_active = trace_now();
+    
+    // One entry per player, plus the parent's channel for resumed sockets.
+    // A player on hold has fd -1, which poll() skips.
+    struct pollfd pfds[3];
+    pfds[0].fd = p1->fd;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = p2->fd;
+    pfds[1].events = POLLIN;
+    pfds[2].fd = ctl_fd;
+    pfds[2].events = POLLIN;
+
+    // SIGUSR2 (eviction) is only let in while waiting in ppoll(), so it
+    // cannot land between checking game->evict and going to sleep
+    sigset_t usr2_mask, wait_mask;
+    sigemptyset(&usr2_mask);
+    sigaddset(&usr2_mask, SIGUSR2);
+    sigprocmask(SIG_BLOCK, &usr2_mask, &wait_mask);
+    sigdelset(&wait_mask, SIGUSR2);
+
+    // Player whose connection dropped and who may still resume, 0 if none
+    int held_player = 0;
+    uint64_t held_until = 0;
+
+    // Messages are framed by their length field, so a read may hold part
+    // of a frame or several of them. Whatever has been read waits in the
+    // player's buffer, and one frame is handled per pass of the loop. A
+    // player who has hung up is only forfeited once their complete frames
+    // have been handled.
+    Connection *conns[2] = { p1, p2 };
+    int hung_up[2] = { 0, 0 };
+    uint64_t t_read[2] = { 0, 0 };
+    char frame[BUFFER_SIZE];
+
+    // Timestamps of the message being handled; its spans close once the
+    // resulting PLAY (or OVER) has been written
+    uint64_t t_recv = 0;
+    uint64_t t_valid = 0;
+
+    // Every message a player sends costs one from their budget. PLAY is
+    // only sent when the board or the turn changed (or to a player who
+    // just resumed), so a rejected message is answered by its FAIL alone.
+    MsgBudget budget[2] = { { 0 }, { 0 } };
+    int play_changed = 1;
+    
+    while (!is_board_empty(game_board))
+    {
+        char board_str[50];
+        snprintf(board_str, sizeof(board_str), "%d %d %d %d %d",
+                 game_board[0], game_board[1], game_board[2], 
+                 game_board[3], game_board[4]);
+
+        // Send PLAY message to both players
+        if (play_changed)
+        {
+            send_message(pfds[0].fd, "PLAY|%d|%s|", current_player, board_str);
+            send_message(pfds[1].fd, "PLAY|%d|%s|", current_player, board_str);
+            play_changed = 0;
+            printf("[GAME] Sent PLAY - Player %d's turn. Board: %s\n", 
+                   current_player, board_str);
+        }
+
+        if (t_recv)
+        {
+            trace_spans(tracer, game_idx, game_idx, t_recv, t_valid, trace_now());
+            t_recv = 0;
+        }
+
+        if (live_table)
+        {
+            live.turn = current_player;
+            live.held = held_player;
+            live.moves = record.move_count;
+            for (int i = 0; i < 5; i++)
+                live.board[i] = game_board[i];
+            live_publish(live_table, game_idx, &live);
+        }
+
+        int has_input[2];
+        for (int p = 0; p < 2; p++)
+            has_input[p] = hung_up[p] || frame_length(conn_buffer(conns[p]), conns[p]->in_len) != 0;
+        int buffered = has_input[0] || has_input[1];
+        
+        // Wait for messages from either player (EXTRA CREDIT), or until
+        // the disconnected player's grace period runs out. With a frame
+        // already buffered, only look for anything new.
+        struct timespec timeout, *wait_for = NULL;
+        if (buffered)
+        {
+            timeout.tv_sec = 0;
+            timeout.tv_nsec = 0;
+            wait_for = &timeout;
+        }
+        else if (held_player)
+        {
+            uint64_t now = trace_now();
+            uint64_t left = now >= held_until ? 0 : held_until - now;
+            timeout.tv_sec = left / 1000000000ull;
+            timeout.tv_nsec = left % 1000000000ull;
+            wait_for = &timeout;
+        }
+        int poll_result;
+        if (__atomic_load_n(&game->evict, __ATOMIC_ACQUIRE))
+        {
+            poll_result = -1;
+            errno = EINTR;
+        }
+        else
+        {
+            poll_result = busy_poll_usec > 0 && !buffered ? spin_poll(game, pfds, 3) : 0;
+            if (poll_result == 0)
+                poll_result = ppoll(pfds, 3, wait_for, &wait_mask);
+        }
+        
+        if (poll_result < 0 && errno == EINTR)
+        {
+            int evict = __atomic_load_n(&game->evict, __ATOMIC_ACQUIRE);
+            if (!evict)
+                continue;
+
+            // Another node holds the name; its claim came first
+            for (int p = 1; p <= 2; p++)
+            {
+                if (evict & (1 << (p - 1)))
+                {
+                    printf("[GAME] Player %d's name belongs to another node\n", p);
+                    send_message(pfds[p - 1].fd, "FAIL|22 Already Playing|");
+                }
+            }
+            if (evict == 3)
+            {
+                record_result(game_idx, &record, &started, 0, 0);
+            }
+            else
+            {
+                int winner = evict == 1 ? 2 : 1;
+                send_message(pfds[winner - 1].fd, "OVER|%d|%s|Forfeit|", winner, board_str);
+                record_result(game_idx, &record, &started, winner, 1);
+            }
+            break;
+        }
+        if (poll_result < 0)
+        {
+            perror("poll error");
+            record_result(game_idx, &record, &started, 0, 0);
+            break;
+        }
+
+        int forfeit_player = 0;
+        int flooded = 0;
+        if (poll_result == 0 && held_player && trace_now() >= held_until)
+        {
+            printf("[GAME] Player %d did not resume in time\n", held_player);
+            forfeit_player = held_player;
+        }
+
+        // A player resuming on a new connection, routed here by the parent
+        if (!forfeit_player && (pfds[2].revents & (POLLIN | POLLHUP)))
+        {
+            int new_fd = -1;
+            int player = 0;
+            int bytes = recv_fd(ctl_fd, &new_fd, &player, sizeof(player));
+            if (bytes <= 0)
+            {
+                pfds[2].fd = -1;   // parent went away; stop listening
+                continue;
+            }
+            if (bytes != (int)sizeof(player))
+            {
+                // A truncated message names no seat
+                if (new_fd >= 0)
+                    close(new_fd);
+                continue;
+            }
+            if (new_fd < 0)
+                continue;
+
+            if (player != held_player)
+            {
+                // That seat is still connected
+                send_message(new_fd, "FAIL|22 Already Playing|");
+                close(new_fd);
+                continue;
+            }
+
+            setup_game_socket(new_fd);
+            conn_get(game->players[player - 1])->fd = new_fd;
+            sample_net(game_idx, player, new_fd, 1);
+            pfds[player - 1].fd = new_fd;
+            held_player = 0;
+            printf("[GAME] Player %d resumed\n", player);
+
+            // Re-introduce the game; the PLAY at the top of the loop tells
+            // both players that play continues
+            send_name(game, player);
+            play_changed = 1;
+            continue;
+        }
+
+        // Take in whatever arrived
+        for (int p = 1; !forfeit_player && p <= 2; p++)
+        {
+            if (pfds[p - 1].fd < 0 || !(pfds[p - 1].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            if (!fill_buffer(conns[p - 1], pfds[p - 1].fd, game_idx))
+                hung_up[p - 1] = 1;
+            t_read[p - 1] = trace_now();
+            live.last_active = t_read[p - 1];
+            sample_net(game_idx, p, pfds[p - 1].fd, 0);
+            has_input[p - 1] = hung_up[p - 1] ||
+                               frame_length(conn_buffer(conns[p - 1]), conns[p - 1]->in_len) != 0;
+        }
+        
+        // Check if non-current player sent a message (impatient). A frame
+        // that cannot be read at all ends the game like any invalid one.
+        int sender = 0;
+        int frame_len = 0;
+        if (!forfeit_player && has_input[other_player - 1])
+        {
+            frame_len = next_frame(conns[other_player - 1], frame);
+            t_recv = t_read[other_player - 1];
+            if (frame_len > 0)
+                live.msgs[other_player - 1]++;
+            
+            if (frame_len == 0)
+            {
+                forfeit_player = other_player;
+            }
+            else if (frame_len < 0)
+            {
+                sender = other_player;
+            }
+            else if (!budget_take(&budget[other_player - 1], trace_now()))
+            {
+                forfeit_player = other_player;
+                flooded = 1;
+            }
+            else
+            {
+                // Player sent message when not their turn - Impatient
+                t_valid = trace_now();
+                printf("[GAME] Player %d sent message out of turn (Impatient)\n", other_player);
+                send_message(pfds[other_player - 1].fd, "FAIL|31 Impatient|");
+                // Continue waiting for correct player
+                continue;
+            }
+        }
+        
+        // Check if current player sent a message or disconnected
+        if (!forfeit_player && !sender && has_input[current_player - 1])
+        {
+            frame_len = next_frame(conns[current_player - 1], frame);
+            t_recv = t_read[current_player - 1];
+            if (frame_len > 0)
+                live.msgs[current_player - 1]++;
+
+            if (frame_len == 0)
+            {
+                forfeit_player = current_player;
+            }
+            else if (frame_len > 0 && !budget_take(&budget[current_player - 1], trace_now()))
+            {
+                forfeit_player = current_player;
+                flooded = 1;
+            }
+            else
+            {
+                sender = current_player;
+            }
+        }
+
+        if (forfeit_player)
+        {
+            if (flooded)
+            {
+                // A player over their message budget is cut off for good
+                printf("[GAME] Player %d exceeded the message budget, cutting off\n",
+                       forfeit_player);
+                send_message(pfds[forfeit_player - 1].fd, "FAIL|34 Flooding|");
+                close(pfds[forfeit_player - 1].fd);
+                pfds[forfeit_player - 1].fd = -1;
+                conn_get(game->players[forfeit_player - 1])->fd = -1;
+            }
+            else if (grace_seconds > 0 && !held_player)
+            {
+                // With a grace period, the first player to drop is put on
+                // hold instead of forfeiting; the opponent is told to wait
+                // Keep the dropped socket's retransmits; a resume starts
+                // a fresh count
+                NetQuality *q = &game_net[forfeit_player - 1];
+                sample_net(game_idx, forfeit_player, pfds[forfeit_player - 1].fd, 1);
+                q->retrans_closed += q->retrans;
+                q->retrans = 0;
+
+                close(pfds[forfeit_player - 1].fd);
+                pfds[forfeit_player - 1].fd = -1;
+                conn_get(game->players[forfeit_player - 1])->fd = -1;
+                conns[forfeit_player - 1]->in_len = 0;
+                hung_up[forfeit_player - 1] = 0;
+                held_player = forfeit_player;
+                held_until = trace_now() + (uint64_t)grace_seconds * 1000000000ull;
+                printf("[GAME] Player %d disconnected. Holding game for %d s\n",
+                       forfeit_player, grace_seconds);
+                send_message(pfds[2 - forfeit_player].fd, "WAIT|");
+                t_recv = 0;
+                continue;
+            }
+
+            // A flooder loses; otherwise whoever was on hold, or else the
+            // player who just left
+            int loser = flooded || !held_player ? forfeit_player : held_player;
+            int winner = 3 - loser;
+            printf("[GAME] Player %d disconnected. Player %d wins by forfeit!\n",
+                   loser, winner);
+            
+            t_valid = trace_now();
+            send_message(pfds[winner - 1].fd, "OVER|%d|%s|Forfeit|", winner, board_str);
+            if (t_recv)
+                trace_spans(tracer, game_idx, game_idx, t_recv, t_valid, trace_now());
+            record_result(game_idx, &record, &started, winner, 1);
+            close_players(pfds);
+            return;
+        }
+
+        if (sender)
+        {
+            int sender_fd = pfds[sender - 1].fd;
+            
+            // Parse the MOVE message
+            int msg_type = PARSE_ERROR;
+            char *tokens[20];
+            if (frame_len > 0)
+            {
+                int token_count = split_message(frame, tokens, 20);
+                msg_type = parse_messages(tokens, token_count);
+            }
+            
+            if (msg_type == MSG_MOVE)
+            {
+                int pile = atoi(tokens[3]);
+                int stones = atoi(tokens[4]);
+                
+                // Validate move
+                if (pile < 0 || pile > 4)
+                {
+                    t_valid = trace_now();
+                    send_message(sender_fd, "FAIL|32 Pile Index|");
+                    continue;
+                }
+                
+                if (stones <= 0 || stones > game_board[pile])
+                {
+                    t_valid = trace_now();
+                    send_message(sender_fd, "FAIL|33 Quantity|");
+                    continue;
+                }
+                t_valid = trace_now();
+                
+                // Execute move
+                game_board[pile] -= stones;
+                if (record.move_count < ARCHIVE_MAX_MOVES)
+                    record.moves[record.move_count++] = ARCHIVE_MOVE(pile, stones);
+                printf("[GAME] Player %d removed %d stones from pile %d\n",
+                       current_player, stones, pile);
+                
+                // Check if game is over
+                if (is_board_empty(game_board))
+                {
+                    // Current player wins (took last stone)
+                    snprintf(board_str, sizeof(board_str), "%d %d %d %d %d",
+                             game_board[0], game_board[1], game_board[2],
+                             game_board[3], game_board[4]);
+                    
+                    send_message(pfds[0].fd, "OVER|%d|%s||", current_player, board_str);
+                    send_message(pfds[1].fd, "OVER|%d|%s||", current_player, board_str);
+                    trace_spans(tracer, game_idx, game_idx, t_recv, t_valid, trace_now());
+                    
+                    printf("[GAME] Game over! Player %d (%s) wins!\n",
+                           current_player, current_player == 1 ? p1_name : p2_name);
+                    record_result(game_idx, &record, &started, current_player, 0);
+                    break;
+                }
+                
+                // Switch turns
+                int temp = current_player;
+                current_player = other_player;
+                other_player = temp;
+                play_changed = 1;
+            }
+            else
+            {
+                // A second OPEN gets its own code; either way the game
+                // cannot go on
+                t_valid = trace_now();
+                send_message(sender_fd, msg_type == MSG_OPEN ? "FAIL|23 Already Open|"
+                                                             : "FAIL|10 Invalid|");
+                trace_spans(tracer, game_idx, game_idx, t_recv, t_valid, trace_now());
+                record_result(game_idx, &record, &started, 0, 0);
+                close_players(pfds);
+                return;
+            }
+        }
+    }
+    
+    // Clean up
+    close_players(pfds);
+    printf("[GAME] Game ended successfully\n");
+}
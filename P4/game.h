@@ -0,0 +1,81 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "ngp.h"
+#include "slab.h"
+#include "trace.h"
+#include "events.h"
+#include "live.h"
+
+// The game core: one game between two connected players, run to the end by
+// handle_game(). The server forks a process per game to run it; the test
+// harness runs it on a thread over socketpairs.
+
+#define BUFFER_SIZE 1024
+#define EVENT_PUSH_RETRIES 1000
+
+// Per-connection state, allocated from conn_pool
+typedef struct {
+    int fd;
+    slab_idx buf;              // index into buffer_pool
+    int in_len;                // bytes buffered in buf, in a game
+    char name[MAX_NAME_LEN];
+} Connection;
+
+// Per-game state, allocated from game_pool
+typedef struct {
+    slab_idx players[2];       // indexes into conn_pool
+    pid_t pid;                 // game process, 0 until forked
+    int registered;            // names in ActivePlayers (parent only)
+    char tokens[2][RESUME_TOKEN_LEN + 1];   // per-seat resume tokens
+    int evict;                 // bit per player whose name another node won
+} Game;
+
+// Wait and CPU accounting, shared by the game processes. Kept with or
+// without -b so the two modes can be compared from the stats dump.
+typedef struct {
+    uint64_t spin_hits;        // waits that ended while spinning
+    uint64_t spin_misses;      // waits that spun out and went to sleep
+    uint64_t spin_ns;          // time spent spinning
+    uint64_t games;            // finished game processes
+    uint64_t cpu_ns;           // their user + system CPU time
+    uint64_t wall_ns;          // their lifetimes
+} WaitStats;
+
+// Server-wide network totals, shared by the game processes. The RTT
+// distributions are in the tracer.
+typedef struct {
+    uint64_t samples;
+    uint64_t games;
+    uint64_t retrans;
+    uint64_t lossy_games;      // games where either player saw a retransmit
+    uint32_t unacked_max;
+} NetStats;
+
+// Set up by the server (or the harness) before the first game starts
+extern Slab *game_pool;
+extern Slab *conn_pool;
+extern Slab *buffer_pool;
+extern EventRing *game_events;
+extern Tracer *tracer;
+extern char *archive_dir;
+extern int grace_seconds;
+extern int busy_poll_usec;
+extern WaitStats *wait_stats;
+extern NetStats *net_stats;
+extern LiveTable *live_table;     // NULL unless the server was given -L
+
+slab_idx conn_alloc(int fd);
+void conn_free(slab_idx idx);
+Connection *conn_get(slab_idx idx);
+char *conn_buffer(Connection *conn);
+void send_message(int fd, const char *format, ...);
+void post_event(GameEvent *event);
+
+// Run a game to the end. ctl_fd carries resumed sockets from the parent,
+// -1 if there is none. Closes the player sockets before returning.
+void handle_game(slab_idx game_idx, int ctl_fd);
+
+#endif
@@ -0,0 +1,734 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include "game.h"
+#include "lobby.h"
+#include "network.h"
+
+// Deterministic test and timing harness for the game core. Each scenario
+// runs handle_game() on a thread of this process, against scripted clients
+// on socketpairs: no ports, no sleeps, no child processes. Every client
+// step waits for exactly the bytes it expects, so a run takes as long as
+// the game loop does, and the same runs give both pass/fail and timing.
+
+#define MAX_STEPS 96
+#define MAX_CLIENTS 3                  // both players, plus a spare connection
+#define CLIENT_IN_SIZE 4096
+#define STEP_TIMEOUT_MS 2000
+#define DEFAULT_ROUNDS 100
+
+#define TOKEN1 "aaaaaaaaaaaaaaaa"
+#define TOKEN2 "bbbbbbbbbbbbbbbb"
+
+// What a scripted client does
+enum {
+    OP_END = 0,
+    OP_SEND,        // frame data as a message; repeat copies in one write
+    OP_RAW,         // write data as it is, partial frames and all
+    OP_SETTLE,      // wait until the game has read all the client wrote
+    OP_EXPECT,      // the next repeat frames from the game are data
+    OP_EOF,         // the game has closed the connection
+    OP_HANGUP,      // close the client's end
+    OP_RESUME,      // hand a new connection for seat data to the game
+    OP_RESUME_SHORT,// the same with a truncated seat number
+};
+
+typedef struct {
+    int op;
+    int client;                        // 1 and 2 start as the players
+    const char *data;
+    int repeat;
+} Step;
+
+typedef struct {
+    const char *name;
+    int grace;                         // grace_seconds for the game
+    int evict;                         // game->evict before it starts
+    int winner;                        // expected result, 0 for none
+    int forfeit;
+    Step steps[MAX_STEPS];
+} Scenario;
+
+// A first message the lobby must turn away, or admit (reply NULL)
+typedef struct {
+    const char *name;
+    const char *frame;
+    const char *taken;                 // the player already waiting
+    const char *playing;               // a name already in a classic game
+    const char *hub;                   // a name a hub seat holds
+    const char *claimed;               // a name the hub takes once admitted
+    const char *reply;                 // what the lobby sends, if anything
+} LobbyCase;
+
+#define SEND(c, msg)        { OP_SEND, c, msg, 1 }
+#define SEND_N(c, msg, n)   { OP_SEND, c, msg, n }
+#define RAW(c, bytes)       { OP_RAW, c, bytes, 1 }
+#define SETTLE(c)           { OP_SETTLE, c, NULL, 1 }
+#define EXPECT(c, msg)      { OP_EXPECT, c, msg, 1 }
+#define EXPECT_N(c, msg, n) { OP_EXPECT, c, msg, n }
+#define EXPECT_EOF(c)       { OP_EOF, c, NULL, 1 }
+#define HANGUP(c)           { OP_HANGUP, c, NULL, 1 }
+#define RESUME(c, seat)     { OP_RESUME, c, seat, 1 }
+#define RESUME_SHORT(c, seat) { OP_RESUME_SHORT, c, seat, 1 }
+#define BOTH(msg)           EXPECT(1, msg), EXPECT(2, msg)
+
+#define START \
+    EXPECT(1, "NAME|1|bob|"), EXPECT(2, "NAME|2|alice|"), BOTH("PLAY|1|1 3 5 7 9|")
+#define START_TOKENS \
+    EXPECT(1, "NAME|1|bob|" TOKEN1 "|"), EXPECT(2, "NAME|2|alice|" TOKEN2 "|"), \
+    BOTH("PLAY|1|1 3 5 7 9|")
+
+// The same short game throughout: player 1 takes the last stone on move 5
+#define MOVE_1 SEND(1, "MOVE|4|9|"), BOTH("PLAY|2|1 3 5 7 0|")
+#define MOVE_2 SEND(2, "MOVE|3|7|"), BOTH("PLAY|1|1 3 5 0 0|")
+#define FINISH \
+    SEND(1, "MOVE|2|5|"), BOTH("PLAY|2|1 3 0 0 0|"), \
+    SEND(2, "MOVE|1|3|"), BOTH("PLAY|1|1 0 0 0 0|"), \
+    SEND(1, "MOVE|0|1|"), BOTH("OVER|1|0 0 0 0 0||"), EXPECT_EOF(1), EXPECT_EOF(2)
+#define FORFEIT_TO(p, board) EXPECT(p, "OVER|" #p "|" board "|Forfeit|"), EXPECT_EOF(p)
+
+static const Scenario scenarios[] = {
+    { "full game", 0, 0, 1, 0, { START, MOVE_1, MOVE_2, FINISH } },
+
+    // The FAIL code table, as far as a game can send it
+    { "fail 10 bad move", 0, 0, 0, 0,
+      { START, SEND(1, "MOVE|x|1|"), EXPECT(1, "FAIL|10 Invalid|"),
+        EXPECT_EOF(1), EXPECT_EOF(2) } },
+    { "fail 10 bad header", 0, 0, 0, 0,
+      { START, RAW(1, "1|09|MOVE|0|1|"), EXPECT(1, "FAIL|10 Invalid|"),
+        EXPECT_EOF(1), EXPECT_EOF(2) } },
+    { "fail 10 empty frame", 0, 0, 0, 0,
+      { START, RAW(1, "0|00|"), EXPECT(1, "FAIL|10 Invalid|"),
+        EXPECT_EOF(1), EXPECT_EOF(2) } },
+    { "fail 10 off turn junk", 0, 0, 0, 0,
+      { START, RAW(2, "hello"), EXPECT(2, "FAIL|10 Invalid|"),
+        EXPECT_EOF(1), EXPECT_EOF(2) } },
+    { "fail 22 evicted", 0, 1, 2, 1,
+      { START, EXPECT(1, "FAIL|22 Already Playing|"), EXPECT_EOF(1),
+        FORFEIT_TO(2, "1 3 5 7 9") } },
+    { "fail 22 both evicted", 0, 3, 0, 0,
+      { START, BOTH("FAIL|22 Already Playing|"), EXPECT_EOF(1), EXPECT_EOF(2) } },
+    { "fail 22 seat taken", 5, 0, 1, 0,
+      { START_TOKENS, RESUME(3, "1"), EXPECT(3, "FAIL|22 Already Playing|"),
+        EXPECT_EOF(3), MOVE_1, MOVE_2, FINISH } },
+    { "fail 23 second open", 0, 0, 0, 0,
+      { START, SEND(1, "OPEN|alice|"), EXPECT(1, "FAIL|23 Already Open|"),
+        EXPECT_EOF(1), EXPECT_EOF(2) } },
+    { "fail 31 impatient", 0, 0, 1, 0,
+      { START, SEND(2, "MOVE|0|1|"), EXPECT(2, "FAIL|31 Impatient|"),
+        MOVE_1, MOVE_2, FINISH } },
+    { "fail 32 pile index", 0, 0, 1, 0,
+      { START, SEND(1, "MOVE|5|1|"), EXPECT(1, "FAIL|32 Pile Index|"),
+        MOVE_1, MOVE_2, FINISH } },
+    { "fail 33 quantity", 0, 0, 1, 0,
+      { START, SEND(1, "MOVE|0|2|"), EXPECT(1, "FAIL|33 Quantity|"),
+        SEND(1, "MOVE|1|0|"), EXPECT(1, "FAIL|33 Quantity|"), MOVE_1, MOVE_2, FINISH } },
+    { "fail 34 flooding", 0, 0, 2, 1,
+      { START, SEND_N(1, "MOVE|0|5|", 40), EXPECT_N(1, "FAIL|33 Quantity|", NGP_BURST),
+        EXPECT(1, "FAIL|34 Flooding|"), EXPECT_EOF(1), FORFEIT_TO(2, "1 3 5 7 9") } },
+    { "fail 34 impatient flood", 0, 0, 1, 1,
+      { START, SEND_N(2, "MOVE|0|1|", 40), EXPECT_N(2, "FAIL|31 Impatient|", NGP_BURST),
+        EXPECT(2, "FAIL|34 Flooding|"), EXPECT_EOF(2), FORFEIT_TO(1, "1 3 5 7 9") } },
+
+    // Forfeits and resumes
+    { "forfeit on turn", 0, 0, 2, 1,
+      { START, HANGUP(1), FORFEIT_TO(2, "1 3 5 7 9") } },
+    { "forfeit off turn", 0, 0, 2, 1,
+      { START, MOVE_1, HANGUP(1), FORFEIT_TO(2, "1 3 5 7 0") } },
+    { "forfeit mid frame", 0, 0, 2, 1,
+      { START, RAW(1, "0|09|MO"), HANGUP(1), FORFEIT_TO(2, "1 3 5 7 9") } },
+    { "resume", 5, 0, 1, 0,
+      { START_TOKENS, HANGUP(2), EXPECT(1, "WAIT|"), RESUME(2, "2"),
+        EXPECT(2, "NAME|2|alice|" TOKEN2 "|"), BOTH("PLAY|1|1 3 5 7 9|"),
+        MOVE_1, MOVE_2, FINISH } },
+    { "resume truncated handoff", 5, 0, 1, 0,
+      { START_TOKENS, HANGUP(2), EXPECT(1, "WAIT|"), RESUME_SHORT(3, "2"), EXPECT_EOF(3),
+        RESUME(2, "2"), EXPECT(2, "NAME|2|alice|" TOKEN2 "|"), BOTH("PLAY|1|1 3 5 7 9|"),
+        MOVE_1, MOVE_2, FINISH } },
+    { "forfeit while held", 5, 0, 1, 1,
+      { START_TOKENS, HANGUP(2), EXPECT(1, "WAIT|"), HANGUP(1) } },
+
+    // Framing: a frame may arrive in pieces, or several in one read
+    { "split frame", 0, 0, 1, 0,
+      { START, RAW(1, "0|09|MO"), SETTLE(1), RAW(1, "VE|4|9|"), BOTH("PLAY|2|1 3 5 7 0|"),
+        RAW(2, "0|0"), SETTLE(2), RAW(2, "9|MOVE|3|7|"), BOTH("PLAY|1|1 3 5 0 0|"),
+        FINISH } },
+    { "coalesced frames", 0, 0, 1, 0,
+      { START, RAW(1, "0|09|MOVE|4|9|0|09|MOVE|3|7|"), EXPECT(1, "PLAY|2|1 3 5 7 0|"),
+        EXPECT(1, "FAIL|31 Impatient|"), EXPECT(2, "PLAY|2|1 3 5 7 0|"), MOVE_2, FINISH } },
+    { "coalesced and split", 0, 0, 1, 0,
+      { START, RAW(1, "0|09|MOVE|0|2|0|09|MOVE|"), EXPECT(1, "FAIL|33 Quantity|"),
+        SETTLE(1), RAW(1, "4|9|"), BOTH("PLAY|2|1 3 5 7 0|"), MOVE_2, FINISH } },
+};
+
+#define SCENARIO_COUNT (int)(sizeof(scenarios) / sizeof(scenarios[0]))
+
+#define NAME_72 "nnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnnn"
+
+// The lobby's verdict on a connection's first message
+static const LobbyCase lobby_cases[] = {
+    { "lobby open", "0|11|OPEN|alice|", NULL, "bob", "carol", NULL, NULL },
+    { "lobby open 72 char name", "0|78|OPEN|" NAME_72 "|", NULL, NULL, NULL, NULL, NULL },
+    { "lobby fail 10 bad open", "0|11|OPEN|a|b|c|", NULL, NULL, NULL, NULL,
+      "0|16|FAIL|10 Invalid|" },
+    { "lobby fail 10 not open", "0|17|PLAY|1|1 3 5 7 9|", NULL, NULL, NULL, NULL,
+      "0|16|FAIL|10 Invalid|" },
+    { "lobby fail 21 long name", "0|79|OPEN|" NAME_72 "n|", NULL, NULL, NULL, NULL,
+      "0|18|FAIL|21 Long Name|" },
+    { "lobby fail 22 playing", "0|11|OPEN|alice|", NULL, "alice", NULL, NULL,
+      "0|24|FAIL|22 Already Playing|" },
+    { "lobby fail 22 waiting", "0|11|OPEN|alice|", "alice", NULL, NULL, NULL,
+      "0|24|FAIL|22 Already Playing|" },
+    { "lobby fail 22 in hub", "0|11|OPEN|alice|", NULL, NULL, "alice", NULL,
+      "0|24|FAIL|22 Already Playing|" },
+    { "lobby fail 22 hub recheck", "0|11|OPEN|alice|", NULL, NULL, NULL, "alice",
+      "0|24|FAIL|22 Already Playing|" },
+    { "lobby fail 24 not playing", "0|09|MOVE|0|1|", NULL, NULL, NULL, NULL,
+      "0|20|FAIL|24 Not Playing|" },
+};
+
+#define LOBBY_CASE_COUNT (int)(sizeof(lobby_cases) / sizeof(lobby_cases[0]))
+
+// One scripted client connection
+typedef struct {
+    int fd;                            // client end, -1 once hung up
+    int server_fd;                     // game's end while we hold it, else -1
+    int in_len;
+    char in[CLIENT_IN_SIZE];
+} Client;
+
+typedef struct {
+    slab_idx game_idx;
+    int ctl_fd;
+} GameThread;
+
+static FILE *report;
+static int verbose = 0;
+
+static void *run_game(void *arg)
+{
+    GameThread *thread = arg;
+    handle_game(thread->game_idx, thread->ctl_fd);
+    return NULL;
+}
+
+// Wait up to STEP_TIMEOUT_MS for the client to become readable
+static int wait_readable(int fd)
+{
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    int result;
+    while ((result = poll(&pfd, 1, STEP_TIMEOUT_MS)) < 0 && errno == EINTR)
+        ;
+    return result;
+}
+
+// Read the next frame from the game into content (without its header).
+// Returns 1, 0 if the game closed the connection first, -1 on timeout.
+static int client_frame(Client *client, char *content, int size)
+{
+    for (;;)
+    {
+        int len = frame_length(client->in, client->in_len);
+        if (len < 0)
+            return -1;
+        if (len > 0)
+        {
+            snprintf(content, size, "%.*s", len - 5, client->in + 5);
+            client->in_len -= len;
+            memmove(client->in, client->in + len, client->in_len);
+            return 1;
+        }
+        if (wait_readable(client->fd) <= 0)
+            return -1;
+        int bytes = read(client->fd, client->in + client->in_len,
+                         CLIENT_IN_SIZE - client->in_len);
+        if (bytes <= 0)
+            return 0;
+        client->in_len += bytes;
+    }
+}
+
+static int write_all(int fd, const char *data, int len)
+{
+    while (len > 0)
+    {
+        int written = write(fd, data, len);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return -1;
+        data += written;
+        len -= written;
+    }
+    return 0;
+}
+
+// Run one step. Returns 0, or -1 with the reason in error.
+static int run_step(const Step *step, Client *clients, int ctl_fd, char *error, int size)
+{
+    Client *client = &clients[step->client - 1];
+    char buffer[CLIENT_IN_SIZE];
+
+    switch (step->op)
+    {
+    case OP_SEND:
+    {
+        int len = 0;
+        int content_len = strlen(step->data);
+        for (int i = 0; i < step->repeat; i++)
+            len += snprintf(buffer + len, sizeof(buffer) - len, "0|%02d|%s",
+                            content_len, step->data);
+        if (write_all(client->fd, buffer, len) < 0)
+        {
+            snprintf(error, size, "client %d: write failed", step->client);
+            return -1;
+        }
+        return 0;
+    }
+    case OP_RAW:
+        if (write_all(client->fd, step->data, strlen(step->data)) < 0)
+        {
+            snprintf(error, size, "client %d: write failed", step->client);
+            return -1;
+        }
+        return 0;
+    case OP_SETTLE:
+    {
+        // The game has taken the bytes once its end has nothing queued
+        uint64_t deadline = trace_now() + STEP_TIMEOUT_MS * 1000000ull;
+        int queued = 0;
+        while (client->server_fd >= 0 && ioctl(client->server_fd, FIONREAD, &queued) == 0 &&
+               queued > 0)
+        {
+            if (trace_now() > deadline)
+            {
+                snprintf(error, size, "client %d: game never read %d bytes", step->client,
+                         queued);
+                return -1;
+            }
+            sched_yield();
+        }
+        return 0;
+    }
+    case OP_EXPECT:
+        for (int i = 0; i < step->repeat; i++)
+        {
+            int got = client_frame(client, buffer, sizeof(buffer));
+            if (got <= 0)
+            {
+                snprintf(error, size, "client %d: expected %s, got %s", step->client,
+                         step->data, got == 0 ? "end of stream" : "nothing");
+                return -1;
+            }
+            if (strcmp(buffer, step->data) != 0)
+            {
+                snprintf(error, size, "client %d: expected %s, got %s", step->client,
+                         step->data, buffer);
+                return -1;
+            }
+        }
+        return 0;
+    case OP_EOF:
+    {
+        int got = client_frame(client, buffer, sizeof(buffer));
+        if (got != 0)
+        {
+            snprintf(error, size, "client %d: expected end of stream, got %s", step->client,
+                     got > 0 ? buffer : "nothing");
+            return -1;
+        }
+        return 0;
+    }
+    case OP_HANGUP:
+        close(client->fd);
+        client->fd = -1;
+        return 0;
+    case OP_RESUME:
+    case OP_RESUME_SHORT:
+    {
+        int pair[2];
+        int seat = atoi(step->data);
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0)
+        {
+            snprintf(error, size, "socketpair: %s", strerror(errno));
+            return -1;
+        }
+        // Like the parent, keep no copy of the game's end, so the game's
+        // close is seen as the end of the stream
+        int sent = send_fd(ctl_fd, pair[0], &seat,
+                           step->op == OP_RESUME_SHORT ? 1 : (int)sizeof(seat));
+        close(pair[0]);
+        if (client->fd >= 0)
+            close(client->fd);
+        client->fd = pair[1];
+        client->server_fd = -1;
+        client->in_len = 0;
+        if (sent < 0)
+        {
+            snprintf(error, size, "client %d: resume handoff failed", step->client);
+            return -1;
+        }
+        return 0;
+    }
+    }
+    snprintf(error, size, "unknown step %d", step->op);
+    return -1;
+}
+
+// Run a scenario once. Returns 0 if it went as scripted, -1 with the
+// reason in error.
+static int run_scenario(const Scenario *sc, char *error, int size)
+{
+    Client clients[MAX_CLIENTS];
+    int pairs[2][2];
+    int ctl[2];
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        clients[i].fd = -1;
+        clients[i].server_fd = -1;
+        clients[i].in_len = 0;
+    }
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[0]) < 0 ||
+        socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[1]) < 0 ||
+        socketpair(AF_UNIX, SOCK_STREAM, 0, ctl) < 0)
+    {
+        perror("socketpair");
+        exit(1);
+    }
+
+    // Seat alice and bob as the lobby would
+    slab_idx game_idx = slab_alloc(game_pool);
+    Game *game = slab_get(game_pool, game_idx);
+    memset(game, 0, sizeof(Game));
+    static const char *names[2] = { "alice", "bob" };
+    static const char *tokens[2] = { TOKEN1, TOKEN2 };
+    for (int p = 0; p < 2; p++)
+    {
+        game->players[p] = conn_alloc(pairs[p][0]);
+        strcpy(conn_get(game->players[p])->name, names[p]);
+        strcpy(game->tokens[p], tokens[p]);
+        clients[p].fd = pairs[p][1];
+        clients[p].server_fd = pairs[p][0];
+    }
+    game->evict = sc->evict;
+    grace_seconds = sc->grace;
+
+    GameThread thread = { game_idx, ctl[1] };
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, run_game, &thread) != 0)
+    {
+        perror("pthread_create");
+        exit(1);
+    }
+
+    int result = 0;
+    for (int i = 0; i < MAX_STEPS && sc->steps[i].op != OP_END; i++)
+    {
+        if (run_step(&sc->steps[i], clients, ctl[0], error, size) < 0)
+        {
+            char reason[256];
+            snprintf(reason, sizeof(reason), "%s", error);
+            snprintf(error, size, "step %d: %s", i + 1, reason);
+            result = -1;
+            break;
+        }
+    }
+
+    // Whatever the script left connected goes away, so the game ends
+    for (int i = 0; i < MAX_CLIENTS; i++)
+    {
+        if (clients[i].fd >= 0)
+            close(clients[i].fd);
+    }
+    close(ctl[0]);
+    pthread_join(tid, NULL);
+    close(ctl[1]);
+
+    GameEvent event;
+    int finished = 0;
+    while (events_pop(game_events, &event) == 0)
+    {
+        if (event.type != EVENT_GAME_FINISHED)
+            continue;
+        finished = 1;
+        if (result == 0 && (event.winner != sc->winner || event.forfeit != sc->forfeit))
+        {
+            snprintf(error, size, "result: winner %d forfeit %d, expected winner %d forfeit %d",
+                     event.winner, event.forfeit, sc->winner, sc->forfeit);
+            result = -1;
+        }
+    }
+    if (result == 0 && !finished)
+    {
+        snprintf(error, size, "no result reported");
+        result = -1;
+    }
+
+    // However it ended, the game must have left the live table
+    LiveGame live;
+    if (result == 0 && (live_read(live_table, game_idx, &live) < 0 || live.state != LIVE_FREE))
+    {
+        snprintf(error, size, "game still in the live table");
+        result = -1;
+    }
+
+    conn_free(game->players[0]);
+    conn_free(game->players[1]);
+    slab_free(game_pool, game_idx);
+    return result;
+}
+
+// Check one lobby case. The frame arrives on a socketpair and goes through
+// the lobby's own step, with the names in use set up first; the client
+// must then get exactly the expected reply and the end of the stream, or
+// nothing at all if the player was admitted.
+static int run_lobby_case(const LobbyCase *lc, char *error, int size)
+{
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0)
+    {
+        perror("socketpair");
+        exit(1);
+    }
+    if (lc->playing)
+        add_active_player(lc->playing);
+    if (lc->hub)
+        mux_name_claim(mux_names, lc->hub, 0, 1);
+
+    slab_idx idx = conn_alloc(pair[0]);
+    Connection *conn = conn_get(idx);
+    write_all(pair[1], lc->frame, strlen(lc->frame));
+    int bytes = read(pair[0], conn_buffer(conn), BUFFER_SIZE - 1);
+    conn_buffer(conn)[bytes > 0 ? bytes : 0] = '\0';
+
+    const char *token;
+    int admitted = lobby_admit(idx, lc->taken, &token) == LOBBY_PLAYER;
+    if (admitted && lc->claimed)
+    {
+        // A hub seat takes the name while the player waits
+        mux_name_claim(mux_names, lc->claimed, 0, 2);
+        admitted = lobby_recheck(idx) == 0;
+    }
+
+    int result = 0;
+    if (admitted)
+    {
+        // Nothing is sent to an admitted player until the pairing
+        struct pollfd pfd = { pair[1], POLLIN, 0 };
+        const char *name = lc->frame + 10;
+        if (lc->reply)
+        {
+            snprintf(error, size, "admitted, expected %s", lc->reply);
+            result = -1;
+        }
+        else if (poll(&pfd, 1, 0) != 0)
+        {
+            snprintf(error, size, "admitted, but the lobby wrote to the client");
+            result = -1;
+        }
+        else if (strncmp(conn->name, name, strlen(name) - 1) != 0 ||
+                 strlen(conn->name) != strlen(name) - 1)
+        {
+            snprintf(error, size, "admitted as %s", conn->name);
+            result = -1;
+        }
+        close(conn->fd);
+        conn_free(idx);
+    }
+    else
+    {
+        // The lobby has sent its reply and closed its end
+        char got[CLIENT_IN_SIZE];
+        int len = 0;
+        while (len < (int)sizeof(got) - 1 &&
+               (bytes = read(pair[1], got + len, sizeof(got) - 1 - len)) > 0)
+            len += bytes;
+        got[len] = '\0';
+        if (!lc->reply)
+        {
+            snprintf(error, size, "refused with %s", got);
+            result = -1;
+        }
+        else if (strcmp(got, lc->reply) != 0)
+        {
+            snprintf(error, size, "sent %s, expected %s", got, lc->reply);
+            result = -1;
+        }
+    }
+    close(pair[1]);
+
+    if (lc->playing)
+        remove_active_player(lc->playing);
+    if (lc->hub)
+        mux_name_release(mux_names, lc->hub, 1);
+    if (lc->claimed)
+        mux_name_release(mux_names, lc->claimed, 2);
+    return result;
+}
+
+static void print_row(const char *name, const Histogram *hist, int failed)
+{
+    fprintf(report, "[CHECK] %-26s %6lu %6d %9.1f %9.1f %9.1f %9.1f\n", name,
+            (unsigned long)hist->count, failed,
+            hist->count ? hist->sum / (double)hist->count / 1000.0 : 0.0,
+            hist_percentile(hist, 50) / 1000.0, hist_percentile(hist, 99) / 1000.0,
+            hist->max / 1000.0);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-v] [-n rounds] [-s scenario]\n", prog);
+    fprintf(stderr, "  -n rounds    runs of each scenario (default %d)\n", DEFAULT_ROUNDS);
+    fprintf(stderr, "  -s scenario  only scenarios whose name contains this\n");
+    fprintf(stderr, "  -v           show the games' own log\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = DEFAULT_ROUNDS;
+    const char *only = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "vn:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'v':
+            verbose = 1;
+            break;
+        case 'n':
+            rounds = atoi(optarg);
+            break;
+        case 's':
+            only = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (rounds < 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // The games log to stdout; the report keeps its own copy of it
+    report = fdopen(dup(STDOUT_FILENO), "w");
+    if (!report)
+    {
+        perror("dup");
+        return 1;
+    }
+    setvbuf(report, NULL, _IOLBF, 0);
+    if (!verbose && !freopen("/dev/null", "w", stdout))
+    {
+        perror("/dev/null");
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);   // games write to clients that hung up
+
+    // One game at a time, so one game slot and two connections
+    game_pool = slab_create(sizeof(Game), 1, 0);
+    conn_pool = slab_create(sizeof(Connection), 2, 0);
+    buffer_pool = slab_create(BUFFER_SIZE, 2, 0);
+    game_events = events_create(16);
+    tracer = trace_create(1, 0);
+    static LiveTable live;
+    if (live_create(NULL, 1, &live) == 0)
+        live_table = &live;
+    wait_stats = calloc(1, sizeof(WaitStats));
+    net_stats = calloc(1, sizeof(NetStats));
+    active_players = calloc(1, sizeof(ActivePlayers));
+    mux_names = mux_names_create();
+    if (!game_pool || !conn_pool || !buffer_pool || !game_events || !tracer ||
+        !live_table || !wait_stats || !net_stats || !active_players || !mux_names)
+    {
+        fprintf(stderr, "Failed to set up the game core\n");
+        return 1;
+    }
+
+    static Histogram game_time[SCENARIO_COUNT];
+    static Histogram lobby_time[LOBBY_CASE_COUNT];
+    int game_failed[SCENARIO_COUNT] = { 0 };
+    int lobby_failed[LOBBY_CASE_COUNT] = { 0 };
+    char error[512];
+    int runs = 0;
+    int failures = 0;
+
+    for (int i = 0; i < SCENARIO_COUNT; i++)
+        hist_clear(&game_time[i]);
+    for (int i = 0; i < LOBBY_CASE_COUNT; i++)
+        hist_clear(&lobby_time[i]);
+
+    // Rounds go across all scenarios, so no scenario gets a warm cache the
+    // others did not
+    uint64_t begin = trace_now();
+    for (int round = 0; round < rounds; round++)
+    {
+        for (int i = 0; i < SCENARIO_COUNT; i++)
+        {
+            if (only && !strstr(scenarios[i].name, only))
+                continue;
+            uint64_t t0 = trace_now();
+            int result = run_scenario(&scenarios[i], error, sizeof(error));
+            hist_record(&game_time[i], trace_now() - t0);
+            runs++;
+            if (result < 0)
+            {
+                if (game_failed[i]++ == 0)
+                    fprintf(report, "[CHECK] FAIL %s: %s\n", scenarios[i].name, error);
+                failures++;
+            }
+        }
+        for (int i = 0; i < LOBBY_CASE_COUNT; i++)
+        {
+            if (only && !strstr(lobby_cases[i].name, only))
+                continue;
+            uint64_t t0 = trace_now();
+            int result = run_lobby_case(&lobby_cases[i], error, sizeof(error));
+            hist_record(&lobby_time[i], trace_now() - t0);
+            runs++;
+            if (result < 0)
+            {
+                if (lobby_failed[i]++ == 0)
+                    fprintf(report, "[CHECK] FAIL %s: %s\n", lobby_cases[i].name, error);
+                failures++;
+            }
+        }
+    }
+    uint64_t elapsed = trace_now() - begin;
+
+    fprintf(report, "[CHECK] %-26s %6s %6s %9s %9s %9s %9s\n", "scenario", "runs", "failed",
+            "mean_us", "p50_us", "p99_us", "max_us");
+    for (int i = 0; i < SCENARIO_COUNT; i++)
+    {
+        if (game_time[i].count)
+            print_row(scenarios[i].name, &game_time[i], game_failed[i]);
+    }
+    for (int i = 0; i < LOBBY_CASE_COUNT; i++)
+    {
+        if (lobby_time[i].count)
+            print_row(lobby_cases[i].name, &lobby_time[i], lobby_failed[i]);
+    }
+
+    // The game loop's own spans over the same runs
+    Histogram span;
+    for (int s = SPAN_RECV_VALIDATE; s <= SPAN_RECV_SEND; s++)
+    {
+        trace_sum(tracer, 0, 1, s, &span);
+        if (span.count)
+            print_row(trace_span_name(s), &span, 0);
+    }
+
+    fprintf(report, "[CHECK] %d runs, %d failed, in %.1f ms (%.0f runs/s)\n", runs, failures,
+            elapsed / 1e6, elapsed ? runs * 1e9 / elapsed : 0.0);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,230 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "live.h"
+
+#define LIVE_MAGIC "NIMLIV1"
+#define LIVE_VERSION 1
+
+struct LiveHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t slots;
+    int32_t server_pid;
+} __attribute__((aligned(64)));
+
+// A slot's sequence number is odd while its writer is part way through an
+// update. Readers copy the game, then check the number did not move. The
+// writer never waits on anyone, and publishing is a few plain stores into
+// the mapping: no system call.
+struct LiveSlot {
+    uint32_t seq;
+    LiveGame game;
+} __attribute__((aligned(64)));
+
+static size_t table_len(uint32_t slots)
+{
+    return sizeof(struct LiveHeader) + (size_t)slots * sizeof(struct LiveSlot);
+}
+
+// Remove what is at path if it is a live table left by a server that has
+// exited. Anything else, including the table of a running server, is left
+// alone and -1 returned.
+static int remove_stale(const char *path)
+{
+    struct stat st;
+    if (lstat(path, &st) < 0)
+    {
+        if (errno == ENOENT)
+            return 0;
+        perror(path);
+        return -1;
+    }
+
+    struct LiveHeader header;
+    int fd = S_ISREG(st.st_mode) ? open(path, O_RDONLY | O_NOFOLLOW) : -1;
+    ssize_t got = fd >= 0 ? pread(fd, &header, sizeof(header), 0) : -1;
+    if (fd >= 0)
+        close(fd);
+    if (got != (ssize_t)sizeof(header) ||
+        memcmp(header.magic, LIVE_MAGIC, sizeof(header.magic)) != 0)
+    {
+        fprintf(stderr, "%s: exists and is not a live game table, not replacing it\n", path);
+        return -1;
+    }
+    if (kill(header.server_pid, 0) == 0 || errno != ESRCH)
+    {
+        fprintf(stderr, "%s: in use by server %d\n", path, header.server_pid);
+        return -1;
+    }
+
+    if (unlink(path) < 0)
+    {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+// Create the table at path, or in anonymous shared memory if path is NULL.
+// Only a table whose server has exited is replaced. Readers still holding
+// it keep their mapping rather than seeing it shrink.
+int live_create(const char *path, uint32_t slots, LiveTable *table)
+{
+    size_t len = table_len(slots);
+    int fd = -1;
+    void *map;
+
+    if (path)
+    {
+        if (remove_stale(path) < 0)
+            return -1;
+        fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0 || ftruncate(fd, len) < 0)
+        {
+            perror(path);
+            if (fd >= 0)
+                close(fd);
+            return -1;
+        }
+        map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    }
+    else
+    {
+        map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    }
+    if (map == MAP_FAILED)
+    {
+        perror("live table mmap failed");
+        return -1;
+    }
+
+    // A new file is all zeroes: every slot free with an even sequence
+    struct LiveHeader *header = map;
+    memcpy(header->magic, LIVE_MAGIC, sizeof(header->magic));
+    header->version = LIVE_VERSION;
+    header->slots = slots;
+    header->server_pid = getpid();
+
+    table->header = header;
+    table->slots = (struct LiveSlot *)(header + 1);
+    table->slot_count = slots;
+    table->server_pid = header->server_pid;
+    table->map_len = len;
+    return 0;
+}
+
+// Map an existing table read-only
+int live_open(const char *path, LiveTable *table)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct LiveHeader))
+    {
+        fprintf(stderr, "%s: not a live game table\n", path);
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror("live table mmap failed");
+        return -1;
+    }
+
+    struct LiveHeader *header = map;
+    if (memcmp(header->magic, LIVE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != LIVE_VERSION ||
+        table_len(header->slots) > (size_t)st.st_size)
+    {
+        fprintf(stderr, "%s: not a live game table\n", path);
+        munmap(map, st.st_size);
+        return -1;
+    }
+
+    table->header = header;
+    table->slots = (struct LiveSlot *)(header + 1);
+    table->slot_count = header->slots;
+    table->server_pid = header->server_pid;
+    table->map_len = st.st_size;
+    return 0;
+}
+
+void live_close(LiveTable *table)
+{
+    if (table->header)
+        munmap(table->header, table->map_len);
+    table->header = NULL;
+    table->slots = NULL;
+}
+
+// Mark the slot as being written. A writer that died part way left the
+// sequence odd; the next one carries on from there.
+static uint32_t write_begin(struct LiveSlot *slot)
+{
+    uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) | 1;
+    __atomic_store_n(&slot->seq, seq, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return seq;
+}
+
+static void write_end(struct LiveSlot *slot, uint32_t seq)
+{
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+// Publish a game's state. Only the process running the game calls this.
+void live_publish(LiveTable *table, uint32_t slot, const LiveGame *game)
+{
+    if (slot >= table->slot_count)
+        return;
+    struct LiveSlot *s = &table->slots[slot];
+    uint32_t seq = write_begin(s);
+    s->game = *game;
+    write_end(s, seq);
+}
+
+// Free a slot: called as a game ends, and by the server for a game process
+// that died without doing so
+void live_clear(LiveTable *table, uint32_t slot)
+{
+    if (slot >= table->slot_count)
+        return;
+    struct LiveSlot *s = &table->slots[slot];
+    uint32_t seq = write_begin(s);
+    memset(&s->game, 0, sizeof(s->game));
+    write_end(s, seq);
+}
+
+// Take a consistent copy of a slot. Returns -1 if every try overlapped an
+// update (or the writer died mid-update).
+int live_read(const LiveTable *table, uint32_t slot, LiveGame *out)
+{
+    if (slot >= table->slot_count)
+        return -1;
+    const struct LiveSlot *s = &table->slots[slot];
+    for (int i = 0; i < LIVE_READ_RETRIES; i++)
+    {
+        uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+        memcpy(out, &s->game, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) == seq)
+            return 0;
+    }
+    return -1;
+}
@@ -0,0 +1,53 @@
+#ifndef LIVE_H
+#define LIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Live game table: one slot per game_pool index, each written only by the
+// process running that game and published under a per-slot seqlock. The
+// table is a shared file mapping, so a reader such as nimtop can map it
+// read-only and watch the games without asking the server anything.
+// Times are CLOCK_MONOTONIC nanoseconds (trace_now()), which any process
+// on the machine can compare against its own clock.
+
+#define LIVE_NAME_LEN 73
+#define LIVE_READ_RETRIES 100
+
+enum {
+    LIVE_FREE = 0,
+    LIVE_PLAYING,
+};
+
+// What a game publishes
+typedef struct {
+    uint8_t state;
+    uint8_t turn;                 // player to move, 1 or 2
+    uint8_t held;                 // player on hold waiting to resume, 0 if none
+    uint8_t moves;
+    uint8_t board[5];
+    int32_t pid;                  // process running the game
+    uint32_t msgs[2];             // frames read from each player
+    uint64_t started;
+    uint64_t last_active;         // last time either player's data was read
+    char names[2][LIVE_NAME_LEN];
+} LiveGame;
+
+// Mapped table, on the server's or a reader's side
+typedef struct {
+    struct LiveHeader *header;
+    struct LiveSlot *slots;
+    uint32_t slot_count;
+    int32_t server_pid;
+    size_t map_len;
+} LiveTable;
+
+int live_create(const char *path, uint32_t slots, LiveTable *table);
+int live_open(const char *path, LiveTable *table);
+void live_close(LiveTable *table);
+
+void live_publish(LiveTable *table, uint32_t slot, const LiveGame *game);
+void live_clear(LiveTable *table, uint32_t slot);
+int live_read(const LiveTable *table, uint32_t slot, LiveGame *out);
+
+#endif
@@ -0,0 +1,121 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "lobby.h"
+
+ActivePlayers *active_players;
+MuxNames *mux_names = NULL;
+Cluster *cluster = NULL;
+
+// Check if player name is already active
+int is_player_active(const char *name)
+{
+    for (int i = 0; i < active_players->count; i++)
+    {
+        if (strcmp(active_players->names[i], name) == 0)
+            return 1;
+    }
+    if (mux_names && mux_name_taken(mux_names, name))
+        return 1;
+    return cluster && cluster_name_taken(cluster, name);
+}
+
+// Add player to active list
+void add_active_player(const char *name)
+{
+    if (active_players->count < MAX_ACTIVE_PLAYERS)
+    {
+        strncpy(active_players->names[active_players->count], name, MAX_NAME_LEN - 1);
+        active_players->names[active_players->count][MAX_NAME_LEN - 1] = '\0';
+        active_players->count++;
+        if (cluster)
+            cluster_claim(cluster, name);
+    }
+}
+
+// Remove player from active list
+void remove_active_player(const char *name)
+{
+    for (int i = 0; i < active_players->count; i++)
+    {
+        if (strcmp(active_players->names[i], name) == 0)
+        {
+            // Shift remaining players down
+            for (int j = i; j < active_players->count - 1; j++)
+            {
+                strcpy(active_players->names[j], active_players->names[j + 1]);
+            }
+            active_players->count--;
+            if (cluster)
+                cluster_release(cluster, name);
+            break;
+        }
+    }
+}
+
+// Send a FAIL to a connection, then close it and free its slot
+static void refuse(slab_idx idx, const char *reply)
+{
+    Connection *conn = conn_get(idx);
+    send_message(conn->fd, "%s", reply);
+    close(conn->fd);
+    conn_free(idx);
+}
+
+// Judge a connection's first message, already read into its buffer and
+// terminated. A valid OPEN for a name that is not playing, and is not
+// taken (the player already waiting), admits the player. A resume request
+// with grace on is left to the caller, with its token. Anything else is
+// refused with the code from the error table.
+int lobby_admit(slab_idx idx, const char *taken, const char **token)
+{
+    Connection *conn = conn_get(idx);
+    char *tokens[20];
+    int token_count = split_message(conn_buffer(conn), tokens, 20);
+
+    int msg_type = parse_messages(tokens, token_count);
+    if (msg_type == MSG_RSUM && grace_seconds > 0)
+    {
+        *token = tokens[3];
+        return LOBBY_RESUME;
+    }
+    int error = open_error(tokens, token_count, msg_type);
+    if (error)
+    {
+        // A name too long (21) or a MOVE before any game (24) gets its
+        // own code; anything else is just invalid
+        if (error == 21)
+            refuse(idx, "FAIL|21 Long Name|");
+        else if (error == 24)
+            refuse(idx, "FAIL|24 Not Playing|");
+        else
+            refuse(idx, "FAIL|10 Invalid|");
+        return LOBBY_REFUSED;
+    }
+
+    strncpy(conn->name, tokens[3], MAX_NAME_LEN - 1);
+    conn->name[MAX_NAME_LEN - 1] = '\0';
+
+    // Check if player already active
+    if (is_player_active(conn->name) || (taken && strcmp(conn->name, taken) == 0))
+    {
+        printf("[SERVER] Rejected duplicate player: %s\n", conn->name);
+        refuse(idx, "FAIL|22 Already Playing|");
+        return LOBBY_REFUSED;
+    }
+    return LOBBY_PLAYER;
+}
+
+// Check a waiting player's name again once their opponent arrives: it may
+// have been claimed elsewhere (on another node or in the hub) meanwhile.
+// Returns -1 if the player was turned away.
+int lobby_recheck(slab_idx idx)
+{
+    Connection *conn = conn_get(idx);
+    if (!is_player_active(conn->name))
+        return 0;
+    printf("[SERVER] Rejected duplicate player: %s\n", conn->name);
+    refuse(idx, "FAIL|22 Already Playing|");
+    return -1;
+}
@@ -0,0 +1,39 @@
+#ifndef LOBBY_H
+#define LOBBY_H
+
+#include "game.h"
+#include "mux.h"
+#include "cluster.h"
+
+// The lobby's side of a new connection: the names in use, and what the
+// connection's first message earns it. The server runs this in the parent
+// as players connect; the test harness runs it over socketpairs.
+
+#define MAX_ACTIVE_PLAYERS 100
+
+// Names of the players in classic games
+typedef struct {
+    char names[MAX_ACTIVE_PLAYERS][MAX_NAME_LEN];
+    int count;
+} ActivePlayers;
+
+// What lobby_admit() made of a first message
+enum {
+    LOBBY_PLAYER,              // a usable OPEN; the name is in the connection
+    LOBBY_REFUSED,             // sent a FAIL; socket and connection released
+    LOBBY_RESUME,              // a resume request, for the caller to route
+};
+
+// Set up by the server (or the harness) before the first connection
+extern ActivePlayers *active_players;
+extern MuxNames *mux_names;       // names seated in the hub, NULL without -m
+extern Cluster *cluster;          // NULL unless the server was given -C
+
+int is_player_active(const char *name);
+void add_active_player(const char *name);
+void remove_active_player(const char *name);
+
+int lobby_admit(slab_idx idx, const char *taken, const char **token);
+int lobby_recheck(slab_idx idx);
+
+#endif
@@ -0,0 +1,1079 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include "mux.h"
+#include "ngp.h"
+#include "network.h"
+#include "archive.h"
+#include "slab.h"
+#include "executor.h"
+
+#define MUX_IN_SIZE 4096
+#define MUX_OUT_SIZE 16384
+#define MUX_HASH_SIZE (MUX_MAX_SEATS * 2)   // seat lookup buckets
+#define MUX_NAME_SLOTS (MUX_MAX_SEATS * 2)
+#define MUX_FRAME_MAX 128                   // 5 header bytes + 99 content
+
+// Names held by hub seats, with the seat and claim holding each. Only the
+// parent uses this set, so it takes no locks.
+enum { NAME_FREE = 0, NAME_USED, NAME_DEAD };
+
+typedef struct {
+    uint32_t state;
+    uint32_t seat;
+    uint32_t claim;
+    char name[MAX_NAME_LEN];
+} NameSlot;
+
+struct MuxNames {
+    NameSlot slots[MUX_NAME_SLOTS];         // open addressing
+};
+
+// One multiplexed client connection
+typedef struct {
+    int fd;
+    int in_len;
+    int out_len;
+    int eof;                   // peer closed; finish buffered frames, then drop
+    int dead;                  // unusable; drop without reading further
+    uint64_t t_recv;           // time of the last read
+    uint64_t next_sample;      // when TCP_INFO is next due
+    slab_idx seats;            // first seat on this connection
+    int seat_count;            // at most MUX_CONN_SEATS
+    char in[MUX_IN_SIZE];
+    char out[MUX_OUT_SIZE];
+} MuxConn;
+
+// One game id on a connection: a player waiting for or sitting in a game
+typedef struct {
+    slab_idx conn;
+    uint32_t gid;
+    slab_idx game;             // SLAB_NONE while waiting
+    int player;                // 1 or 2 once matched
+    slab_idx conn_prev, conn_next;
+    slab_idx bucket_next;
+    MsgBudget budget;          // MOVE frames this seat may still send
+    uint32_t claim;            // id of the claim on its name, 0 if none
+    int named;                 // the parent granted the name
+    char name[MAX_NAME_LEN];
+} MuxSeat;
+
+typedef struct {
+    slab_idx seats[2];
+    int board[5];
+    int turn;
+    struct timespec started;
+    GameRecord record;
+    LiveGame live;             // as last published, with -L
+} MuxGame;
+
+// Archive write handed to a worker thread, so the disk stays off the loop
+typedef struct {
+    slab_idx idx;
+    int result;
+    GameRecord record;
+} ArchiveJob;
+
+static const MuxConfig *config;
+static Executor *executor;                  // NULL when archiving inline
+static Slab *mux_jobs;
+static Slab *mux_conns;
+static Slab *mux_seats;
+static Slab *mux_games;
+static slab_idx buckets[MUX_HASH_SIZE];
+static slab_idx live[MUX_MAX_CONNECTIONS];  // connections in poll order
+static int live_count;
+// The handoff socket, then connections in live[] order, then the
+// executor's completion pipe
+static struct pollfd pfds[MUX_MAX_CONNECTIONS + 2];
+static slab_idx waiting = SLAB_NONE;        // seat waiting for an opponent
+
+// Events the ring had no room for, oldest first. They go out ahead of any
+// new ones on every round, so none is lost and the parent sees them in order.
+static GameEvent *outbox;
+static int outbox_head, outbox_len, outbox_cap;
+static int posted;                          // the parent has events to drain
+static uint32_t next_claim = 1;
+
+// FNV-1a over the player name
+static uint32_t hash_name(const char *name)
+{
+    uint32_t h = 2166136261u;
+    for (; *name; name++)
+    {
+        h ^= (unsigned char)*name;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+MuxNames *mux_names_create(void)
+{
+    MuxNames *names = calloc(1, sizeof(MuxNames));
+    if (!names)
+        perror("mux names");
+    return names;
+}
+
+void mux_names_destroy(MuxNames *names)
+{
+    free(names);
+}
+
+int mux_name_taken(MuxNames *names, const char *name)
+{
+    uint32_t i = hash_name(name) % MUX_NAME_SLOTS;
+    for (int n = 0; n < MUX_NAME_SLOTS; n++, i = (i + 1) % MUX_NAME_SLOTS)
+    {
+        if (names->slots[i].state == NAME_FREE)
+            return 0;
+        if (names->slots[i].state == NAME_USED && strcmp(names->slots[i].name, name) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// Add a name for a seat's claim, reusing the first dead slot on its probe
+// path. Returns -1 if the name is already held.
+int mux_name_claim(MuxNames *names, const char *name, uint32_t seat, uint32_t claim)
+{
+    int target = -1;
+    uint32_t i = hash_name(name) % MUX_NAME_SLOTS;
+    for (int n = 0; n < MUX_NAME_SLOTS; n++, i = (i + 1) % MUX_NAME_SLOTS)
+    {
+        NameSlot *slot = &names->slots[i];
+        if (slot->state == NAME_USED)
+        {
+            if (strcmp(slot->name, name) == 0)
+                return -1;
+            continue;
+        }
+        if (target < 0)
+            target = i;
+        if (slot->state == NAME_FREE)
+            break;
+    }
+    if (target < 0)
+        return -1;
+
+    NameSlot *slot = &names->slots[target];
+    strncpy(slot->name, name, MAX_NAME_LEN - 1);
+    slot->name[MAX_NAME_LEN - 1] = '\0';
+    slot->seat = seat;
+    slot->claim = claim;
+    slot->state = NAME_USED;
+    return 0;
+}
+
+// Drop a name if this claim holds it. Returns -1 if it does not, as for a
+// claim that was denied.
+int mux_name_release(MuxNames *names, const char *name, uint32_t claim)
+{
+    uint32_t i = hash_name(name) % MUX_NAME_SLOTS;
+    for (int n = 0; n < MUX_NAME_SLOTS; n++, i = (i + 1) % MUX_NAME_SLOTS)
+    {
+        NameSlot *slot = &names->slots[i];
+        if (slot->state == NAME_FREE)
+            return -1;
+        if (slot->state == NAME_USED && strcmp(slot->name, name) == 0)
+        {
+            if (slot->claim != claim)
+                return -1;
+            slot->state = NAME_DEAD;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Call fn for every name held
+void mux_names_each(MuxNames *names,
+                    void (*fn)(const char *name, uint32_t seat, uint32_t claim))
+{
+    for (int i = 0; i < MUX_NAME_SLOTS; i++)
+    {
+        NameSlot *slot = &names->slots[i];
+        if (slot->state == NAME_USED)
+            fn(slot->name, slot->seat, slot->claim);
+    }
+}
+
+// Answer a claim (parent side)
+int mux_verdict(int ctl_fd, int op, uint32_t seat, uint32_t claim)
+{
+    MuxVerdict verdict = { .op = op, .seat = seat, .claim = claim };
+    return send(ctl_fd, &verdict, sizeof(verdict), 0) < 0 ? -1 : 0;
+}
+
+// Move queued events into the ring until it is full again
+static void flush_outbox(void)
+{
+    while (outbox_len > 0 && events_push(config->events, &outbox[outbox_head]) == 0)
+    {
+        outbox_head++;
+        outbox_len--;
+        posted = 1;
+    }
+    if (outbox_len == 0)
+        outbox_head = 0;
+}
+
+// Hand an event to the parent, queueing it if the ring is full
+static void post_event(const GameEvent *event)
+{
+    if (outbox_len == 0 && events_push(config->events, event) == 0)
+    {
+        posted = 1;
+        return;
+    }
+
+    if (outbox_head + outbox_len == outbox_cap)
+    {
+        if (outbox_head > 0)
+        {
+            memmove(outbox, outbox + outbox_head, outbox_len * sizeof(GameEvent));
+            outbox_head = 0;
+        }
+        else
+        {
+            int cap = outbox_cap ? outbox_cap * 2 : 256;
+            GameEvent *grown = realloc(outbox, cap * sizeof(GameEvent));
+            if (!grown)
+            {
+                printf("[MUX] Out of memory, event for the parent dropped\n");
+                return;
+            }
+            outbox = grown;
+            outbox_cap = cap;
+        }
+    }
+    outbox[outbox_head + outbox_len++] = *event;
+}
+
+// Wake the parent once per round if anything was posted
+static void wake_parent(void)
+{
+    if (posted && write(config->wake_fd, "", 1) < 0)
+        ;   // full pipe: a wakeup is already pending
+    posted = 0;
+}
+
+static MuxConn *conn_at(slab_idx idx)
+{
+    return slab_get(mux_conns, idx);
+}
+
+static MuxSeat *seat_at(slab_idx idx)
+{
+    return slab_get(mux_seats, idx);
+}
+
+static MuxGame *game_at(slab_idx idx)
+{
+    return slab_get(mux_games, idx);
+}
+
+// Write out as much queued output as the socket takes without blocking
+static void flush_conn(MuxConn *conn)
+{
+    int sent = 0;
+    while (sent < conn->out_len)
+    {
+        ssize_t n = write(conn->fd, conn->out + sent, conn->out_len - sent);
+        if (n > 0)
+        {
+            sent += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+        conn->dead = 1;
+        break;
+    }
+    memmove(conn->out, conn->out + sent, conn->out_len - sent);
+    conn->out_len -= sent;
+}
+
+// Queue a version 1 frame. The content is "TYPE|gid|...|".
+static void mux_send(slab_idx conn_idx, const char *format, ...)
+{
+    MuxConn *conn = conn_at(conn_idx);
+    if (conn->dead)
+        return;
+
+    char content[MUX_FRAME_MAX];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(content, sizeof(content), format, args);
+    va_end(args);
+
+    char frame[MUX_FRAME_MAX + 8];
+    int len = snprintf(frame, sizeof(frame), "1|%02d|%s", (int)strlen(content), content);
+
+    if (conn->out_len + len > MUX_OUT_SIZE)
+        flush_conn(conn);
+    if (conn->out_len + len > MUX_OUT_SIZE)
+    {
+        // The client is not reading its replies; drop it rather than let
+        // it hold up the games of every other connection
+        printf("[MUX] Connection %u is not reading, dropping it\n", conn_idx);
+        conn->dead = 1;
+        return;
+    }
+    memcpy(conn->out + conn->out_len, frame, len);
+    conn->out_len += len;
+}
+
+static uint32_t seat_hash(slab_idx conn, uint32_t gid)
+{
+    return (conn * 2654435761u ^ gid * 40503u) % MUX_HASH_SIZE;
+}
+
+static slab_idx seat_find(slab_idx conn, uint32_t gid)
+{
+    slab_idx idx = buckets[seat_hash(conn, gid)];
+    while (idx != SLAB_NONE)
+    {
+        MuxSeat *seat = seat_at(idx);
+        if (seat->conn == conn && seat->gid == gid)
+            return idx;
+        idx = seat->bucket_next;
+    }
+    return SLAB_NONE;
+}
+
+// Ask the parent for a seat's name, or give it back
+static void post_name(int type, slab_idx idx)
+{
+    MuxSeat *seat = seat_at(idx);
+    GameEvent event;
+    memset(&event, 0, sizeof(event));
+    event.type = type;
+    event.pid = getpid();
+    event.game = idx;
+    event.claim = seat->claim;
+    strncpy(event.names[0], seat->name, EVENT_NAME_LEN - 1);
+    post_event(&event);
+}
+
+static slab_idx seat_add(slab_idx conn_idx, uint32_t gid, const char *name)
+{
+    slab_idx idx = slab_alloc(mux_seats);
+    if (idx == SLAB_NONE)
+        return SLAB_NONE;
+
+    MuxSeat *seat = seat_at(idx);
+    MuxConn *conn = conn_at(conn_idx);
+    seat->conn = conn_idx;
+    seat->gid = gid;
+    seat->game = SLAB_NONE;
+    seat->player = 0;
+    seat->budget.full_at = 0;
+    seat->named = 0;
+    strncpy(seat->name, name, MAX_NAME_LEN - 1);
+    seat->name[MAX_NAME_LEN - 1] = '\0';
+
+    uint32_t h = seat_hash(conn_idx, gid);
+    seat->bucket_next = buckets[h];
+    buckets[h] = idx;
+
+    seat->conn_prev = SLAB_NONE;
+    seat->conn_next = conn->seats;
+    if (conn->seats != SLAB_NONE)
+        seat_at(conn->seats)->conn_prev = idx;
+    conn->seats = idx;
+    conn->seat_count++;
+
+    // The seat plays once the parent grants its name (handle_verdict)
+    seat->claim = next_claim++;
+    if (next_claim == 0)
+        next_claim = 1;
+    post_name(EVENT_MUX_CLAIM, idx);
+    return idx;
+}
+
+// Unlink a seat from its bucket and connection and give back its name
+static void seat_remove(slab_idx idx)
+{
+    MuxSeat *seat = seat_at(idx);
+    MuxConn *conn = conn_at(seat->conn);
+
+    slab_idx *link = &buckets[seat_hash(seat->conn, seat->gid)];
+    while (*link != idx)
+        link = &seat_at(*link)->bucket_next;
+    *link = seat->bucket_next;
+
+    if (seat->conn_prev != SLAB_NONE)
+        seat_at(seat->conn_prev)->conn_next = seat->conn_next;
+    else
+        conn->seats = seat->conn_next;
+    if (seat->conn_next != SLAB_NONE)
+        seat_at(seat->conn_next)->conn_prev = seat->conn_prev;
+    conn->seat_count--;
+
+    if (waiting == idx)
+        waiting = SLAB_NONE;
+    if (seat->claim)
+        post_name(EVENT_MUX_RELEASE, idx);   // granted or still pending
+    seat->claim = 0;
+    slab_free(mux_seats, idx);
+}
+
+static void board_string(MuxGame *game, char *out, size_t size)
+{
+    snprintf(out, size, "%d %d %d %d %d", game->board[0], game->board[1],
+             game->board[2], game->board[3], game->board[4]);
+}
+
+static void send_play(MuxGame *game)
+{
+    char board_str[32];
+    board_string(game, board_str, sizeof(board_str));
+    for (int i = 0; i < 2; i++)
+    {
+        MuxSeat *seat = seat_at(game->seats[i]);
+        mux_send(seat->conn, "PLAY|%u|%d|%s|", seat->gid, game->turn, board_str);
+    }
+}
+
+// Publish a game's state in its live table slot, if there is a table
+static void publish_game(slab_idx idx)
+{
+    if (!config->live)
+        return;
+    MuxGame *game = game_at(idx);
+    game->live.turn = game->turn;
+    game->live.moves = game->record.move_count;
+    for (int i = 0; i < 5; i++)
+        game->live.board[i] = game->board[i];
+    live_publish(config->live, config->live_base + idx, &game->live);
+}
+
+static void game_start(slab_idx first, slab_idx second)
+{
+    slab_idx idx = slab_alloc(mux_games);   // cannot run out, see MUX_MAX_GAMES
+    MuxGame *game = game_at(idx);
+    memset(game, 0, sizeof(*game));
+    game->seats[0] = first;
+    game->seats[1] = second;
+    game->turn = 1;
+    for (int i = 0; i < 5; i++)
+        game->board[i] = 2 * i + 1;
+    clock_gettime(CLOCK_MONOTONIC, &game->started);
+
+    MuxSeat *p1 = seat_at(first);
+    MuxSeat *p2 = seat_at(second);
+    p1->game = p2->game = idx;
+    p1->player = 1;
+    p2->player = 2;
+    strncpy(game->record.p1, p1->name, ARCHIVE_NAME_LEN - 1);
+    strncpy(game->record.p2, p2->name, ARCHIVE_NAME_LEN - 1);
+    game->live.state = LIVE_PLAYING;
+    game->live.pid = getpid();
+    strncpy(game->live.names[0], p1->name, LIVE_NAME_LEN - 1);
+    strncpy(game->live.names[1], p2->name, LIVE_NAME_LEN - 1);
+    game->live.started = game->live.last_active = trace_now();
+    publish_game(idx);
+
+    mux_send(p1->conn, "NAME|%u|1|%s|", p1->gid, p2->name);
+    mux_send(p2->conn, "NAME|%u|2|%s|", p2->gid, p1->name);
+    send_play(game);
+    printf("[MUX] Game %u started: %s vs %s\n", idx, p1->name, p2->name);
+}
+
+static void archive_run(void *arg)
+{
+    ArchiveJob *job = arg;
+    job->result = archive_append(config->archive_dir, &job->record);
+}
+
+static void archive_done(void *arg)
+{
+    ArchiveJob *job = arg;
+    if (job->result < 0)
+        printf("[MUX] Failed to archive game %s vs %s\n", job->record.p1, job->record.p2);
+    slab_free(mux_jobs, job->idx);
+}
+
+// Append a finished game to the archive on a worker, or inline when there
+// are no workers or all their queues are full
+static void archive_game(const GameRecord *record)
+{
+    slab_idx idx = executor ? slab_alloc(mux_jobs) : SLAB_NONE;
+    if (idx != SLAB_NONE)
+    {
+        ArchiveJob *job = slab_get(mux_jobs, idx);
+        job->idx = idx;
+        job->record = *record;
+        if (executor_submit(executor, archive_run, archive_done, job) == 0)
+            return;
+        slab_free(mux_jobs, idx);
+    }
+    if (archive_append(config->archive_dir, record) < 0)
+        printf("[MUX] Failed to archive game %s vs %s\n", record->p1, record->p2);
+}
+
+// Report a finished game to the parent, archive it and release it with
+// both of its seats. The parent records the result in the player stats.
+static void game_finish(slab_idx idx, int winner, int forfeit)
+{
+    MuxGame *game = game_at(idx);
+    GameRecord *record = &game->record;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    record->winner = winner;
+    record->forfeit = forfeit;
+    record->end_time = time(NULL);
+    record->duration_ms = (now.tv_sec - game->started.tv_sec) * 1000 +
+                          (now.tv_nsec - game->started.tv_nsec) / 1000000;
+
+    const char *winner_name = winner == 1 ? record->p1 : record->p2;
+    const char *loser_name = winner == 1 ? record->p2 : record->p1;
+    printf("[MUX] Game %u over: %s beat %s%s in %u moves, %u ms\n", idx, winner_name,
+           loser_name, forfeit ? " by forfeit" : "", record->move_count, record->duration_ms);
+
+    GameEvent event;
+    memset(&event, 0, sizeof(event));
+    event.type = EVENT_MUX_FINISHED;
+    event.pid = getpid();
+    event.game = idx;
+    event.winner = winner;
+    event.forfeit = forfeit;
+    event.moves = record->move_count;
+    event.duration_ms = record->duration_ms;
+    strncpy(event.names[0], record->p1, EVENT_NAME_LEN - 1);
+    strncpy(event.names[1], record->p2, EVENT_NAME_LEN - 1);
+    post_event(&event);
+
+    if (config->archive_dir)
+        archive_game(record);
+    if (config->live)
+        live_clear(config->live, config->live_base + idx);
+
+    seat_remove(game->seats[0]);
+    seat_remove(game->seats[1]);
+    slab_free(mux_games, idx);
+}
+
+static void game_forfeit(slab_idx idx, int loser)
+{
+    MuxGame *game = game_at(idx);
+    int winner = 3 - loser;
+    MuxSeat *seat = seat_at(game->seats[winner - 1]);
+    char board_str[32];
+    board_string(game, board_str, sizeof(board_str));
+    mux_send(seat->conn, "OVER|%u|%d|%s|Forfeit|", seat->gid, winner, board_str);
+    game_finish(idx, winner, 1);
+}
+
+// Drop a seat, forfeiting its game if it is in one
+static void seat_leave(slab_idx idx)
+{
+    MuxSeat *seat = seat_at(idx);
+    if (seat->game != SLAB_NONE)
+        game_forfeit(seat->game, seat->player);
+    else
+        seat_remove(idx);
+}
+
+static void handle_open(slab_idx conn_idx, uint32_t gid, const char *name)
+{
+    if (seat_find(conn_idx, gid) != SLAB_NONE)
+    {
+        mux_send(conn_idx, "FAIL|%u|23 Already Open|", gid);
+        return;
+    }
+    // One connection may not take the seats every other client needs
+    if (conn_at(conn_idx)->seat_count >= MUX_CONN_SEATS)
+    {
+        mux_send(conn_idx, "FAIL|%u|25 Too Many Games|", gid);
+        return;
+    }
+    // Every seat can still add a claim, release and result to the outbox,
+    // so refusing new seats while it is long keeps it bounded
+    if (outbox_len >= MUX_MAX_SEATS)
+    {
+        printf("[MUX] Parent is behind, refusing game %u\n", gid);
+        mux_send(conn_idx, "FAIL|%u|10 Invalid|", gid);
+        return;
+    }
+
+    slab_idx idx = seat_add(conn_idx, gid, name);
+    if (idx == SLAB_NONE)
+    {
+        printf("[MUX] Seat pool exhausted, refusing game %u\n", gid);
+        mux_send(conn_idx, "FAIL|%u|10 Invalid|", gid);
+    }
+}
+
+// Pair a seat whose name was granted with the waiting one, or make it wait
+static void seat_ready(slab_idx idx)
+{
+    MuxSeat *seat = seat_at(idx);
+    if (waiting == SLAB_NONE)
+    {
+        waiting = idx;
+        mux_send(seat->conn, "WAIT|%u|", seat->gid);
+        return;
+    }
+    slab_idx first = waiting;
+    waiting = SLAB_NONE;
+    game_start(first, idx);
+}
+
+// Apply the parent's answer to a claim, or its eviction of a granted
+// name. A seat that has gone since, or been replaced, no longer has the
+// claim id and is left alone.
+static void handle_verdict(const MuxVerdict *verdict)
+{
+    if (verdict->seat >= MUX_MAX_SEATS)
+        return;
+    MuxSeat *seat = seat_at(verdict->seat);
+    if (seat->claim != verdict->claim)
+        return;
+
+    if (verdict->op == MUX_EVICT)
+    {
+        if (!seat->named)
+            return;
+        printf("[MUX] %s was won by another node, evicting game %u\n", seat->name, seat->gid);
+        mux_send(seat->conn, "FAIL|%u|22 Already Playing|", seat->gid);
+        seat_leave(verdict->seat);
+        return;
+    }
+    if (seat->named)
+        return;
+
+    if (verdict->op == MUX_DENY)
+    {
+        printf("[MUX] Rejected duplicate player: %s\n", seat->name);
+        mux_send(seat->conn, "FAIL|%u|22 Already Playing|", seat->gid);
+        seat->claim = 0;   // nothing to give back
+        seat_remove(verdict->seat);
+        return;
+    }
+    seat->named = 1;
+    seat_ready(verdict->seat);
+}
+
+// Apply a MOVE. Returns 1 if it ended the game, which is then released.
+static int handle_move(slab_idx seat_idx, int pile, int stones)
+{
+    MuxSeat *seat = seat_at(seat_idx);
+    MuxGame *game = game_at(seat->game);
+
+    if (seat->player != game->turn)
+    {
+        mux_send(seat->conn, "FAIL|%u|31 Impatient|", seat->gid);
+        return 0;
+    }
+    if (pile < 0 || pile > 4)
+    {
+        mux_send(seat->conn, "FAIL|%u|32 Pile Index|", seat->gid);
+        return 0;
+    }
+    if (stones <= 0 || stones > game->board[pile])
+    {
+        mux_send(seat->conn, "FAIL|%u|33 Quantity|", seat->gid);
+        return 0;
+    }
+
+    game->board[pile] -= stones;
+    if (game->record.move_count < ARCHIVE_MAX_MOVES)
+        game->record.moves[game->record.move_count++] = ARCHIVE_MOVE(pile, stones);
+
+    if (is_board_empty(game->board))
+    {
+        // Current player wins (took last stone)
+        char board_str[32];
+        board_string(game, board_str, sizeof(board_str));
+        for (int i = 0; i < 2; i++)
+        {
+            MuxSeat *s = seat_at(game->seats[i]);
+            mux_send(s->conn, "OVER|%u|%d|%s||", s->gid, game->turn, board_str);
+        }
+        game_finish(seat->game, game->turn, 0);
+        return 1;
+    }
+
+    game->turn = 3 - game->turn;
+    send_play(game);
+    return 0;
+}
+
+// Handle one complete frame. Returns -1 if the stream can no longer be
+// trusted (bad version or game id), in which case the connection is dropped.
+static int handle_frame(slab_idx conn_idx, char *frame)
+{
+    char *tokens[20];
+    int count = split_message(frame, tokens, 20);
+    if (count < 4 || strcmp(tokens[0], "1") != 0 || !isdigit((unsigned char)tokens[3][0]))
+        return -1;
+
+    char *end;
+    unsigned long gid = strtoul(tokens[3], &end, 10);
+    if (*end != '\0' || gid > MUX_MAX_GID)
+        return -1;
+
+    // Without its game id, the frame is an ordinary version 0 message
+    char *msg[20];
+    msg[0] = "0";
+    msg[1] = tokens[1];
+    msg[2] = tokens[2];
+    for (int i = 4; i <= count; i++)
+        msg[i - 1] = tokens[i];
+    int msg_type = parse_messages(msg, count - 1);
+
+    if (msg_type == MSG_OPEN)
+    {
+        handle_open(conn_idx, gid, msg[3]);
+        return 0;
+    }
+
+    slab_idx seat_idx = seat_find(conn_idx, gid);
+    if (msg_type == MSG_MOVE && (seat_idx == SLAB_NONE || seat_at(seat_idx)->game == SLAB_NONE))
+    {
+        mux_send(conn_idx, "FAIL|%lu|24 Not Playing|", gid);
+        return 0;
+    }
+    if (msg_type != MSG_MOVE)
+    {
+        // A bad message costs only the game it names
+        mux_send(conn_idx, "FAIL|%lu|10 Invalid|", gid);
+        if (seat_idx != SLAB_NONE)
+            seat_leave(seat_idx);
+        return 0;
+    }
+
+    // A seat over its message budget forfeits its game
+    if (!budget_take(&seat_at(seat_idx)->budget, trace_now()))
+    {
+        printf("[MUX] Game id %lu exceeded the message budget, forfeiting\n", gid);
+        mux_send(conn_idx, "FAIL|%lu|34 Flooding|", gid);
+        seat_leave(seat_idx);
+        return 0;
+    }
+
+    // Count the frame for nimtop, and show the board it leaves
+    MuxSeat *seat = seat_at(seat_idx);
+    slab_idx game_idx = seat->game;
+    MuxGame *game = game_at(game_idx);
+    game->live.msgs[seat->player - 1]++;
+    game->live.last_active = conn_at(conn_idx)->t_recv;
+    if (handle_move(seat_idx, atoi(msg[3]), atoi(msg[4])) == 0)
+        publish_game(game_idx);
+    return 0;
+}
+
+// Handle at most MUX_FRAME_BUDGET buffered frames, so that a connection
+// with a deep pipeline waits its turn behind the others. Returns 1 if a
+// complete frame is still buffered.
+static int process_conn(slab_idx conn_idx)
+{
+    MuxConn *conn = conn_at(conn_idx);
+    uint64_t t_valid[MUX_FRAME_BUDGET];
+    int handled = 0;
+    int offset = 0;
+    int more = 0;
+
+    while (!conn->dead)
+    {
+        int avail = conn->in_len - offset;
+        if (avail < 5)
+            break;
+
+        char *p = conn->in + offset;
+        if (p[0] != '1' || p[1] != '|' || !isdigit((unsigned char)p[2]) ||
+            !isdigit((unsigned char)p[3]) || p[4] != '|')
+        {
+            mux_send(conn_idx, "FAIL|0|10 Invalid|");
+            conn->dead = 1;
+            break;
+        }
+        int len = 5 + (p[2] - '0') * 10 + (p[3] - '0');
+        if (avail < len)
+            break;
+        if (handled == MUX_FRAME_BUDGET)
+        {
+            more = 1;
+            break;
+        }
+
+        char frame[MUX_FRAME_MAX];
+        memcpy(frame, p, len);
+        frame[len] = '\0';
+        offset += len;
+
+        if (handle_frame(conn_idx, frame) < 0)
+        {
+            mux_send(conn_idx, "FAIL|0|10 Invalid|");
+            conn->dead = 1;
+        }
+        t_valid[handled++] = trace_now();
+    }
+
+    memmove(conn->in, conn->in + offset, conn->in_len - offset);
+    conn->in_len -= offset;
+
+    if (handled)
+    {
+        // Replies to this connection go out now; replies to opponents on
+        // other connections go out at the end of the round
+        flush_conn(conn);
+        uint64_t t_sent = trace_now();
+        for (int i = 0; i < handled; i++)
+            trace_spans(config->tracer, config->trace_slot, conn_idx,
+                        conn->t_recv, t_valid[i], t_sent);
+    }
+    return more;
+}
+
+// Whether the input buffer starts with a complete frame (or a bad header,
+// which the next pass will reject)
+static int pending_frame(MuxConn *conn)
+{
+    if (conn->in_len < 5)
+        return 0;
+    if (!isdigit((unsigned char)conn->in[2]) || !isdigit((unsigned char)conn->in[3]))
+        return 1;
+    return conn->in_len >= 5 + (conn->in[2] - '0') * 10 + (conn->in[3] - '0');
+}
+
+// Record the connection's RTT in the hub's trace slot, at most once per
+// NET_SAMPLE_MS however many frames it sends
+static void sample_net(MuxConn *conn)
+{
+    if (conn->t_recv < conn->next_sample)
+        return;
+    conn->next_sample = conn->t_recv + NET_SAMPLE_MS * 1000000ull;
+
+    NetSample sample;
+    if (net_sample(conn->fd, &sample) < 0)
+        return;
+    trace_record(config->tracer, config->trace_slot, SPAN_NET_RTT, (uint64_t)sample.rtt_us * 1000);
+    trace_record(config->tracer, config->trace_slot, SPAN_NET_RTTVAR,
+                 (uint64_t)sample.rttvar_us * 1000);
+}
+
+static void read_conn(MuxConn *conn)
+{
+    int space = MUX_IN_SIZE - conn->in_len;
+    if (space == 0)
+        return;
+
+    ssize_t n = read(conn->fd, conn->in + conn->in_len, space);
+    if (n > 0)
+    {
+        conn->in_len += n;
+        conn->t_recv = trace_now();
+        sample_net(conn);
+    }
+    else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+    {
+        conn->eof = 1;
+    }
+}
+
+// Forfeit every game on a connection and release it
+static void close_conn(int live_pos)
+{
+    slab_idx idx = live[live_pos];
+    MuxConn *conn = conn_at(idx);
+    conn->dead = 1;
+    while (conn->seats != SLAB_NONE)
+        seat_leave(conn->seats);
+
+    close(conn->fd);
+    live[live_pos] = live[--live_count];
+    slab_free(mux_conns, idx);
+    printf("[MUX] Connection %u closed (%d live)\n", idx, live_count);
+}
+
+// Take over a connection from the parent
+static void accept_conn(int fd, const char *data, int bytes)
+{
+    slab_idx idx = live_count < MUX_MAX_CONNECTIONS ? slab_alloc(mux_conns) : SLAB_NONE;
+    if (idx == SLAB_NONE)
+    {
+        printf("[MUX] Connection pool exhausted, refusing connection\n");
+        close(fd);
+        return;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    MuxConn *conn = conn_at(idx);
+    conn->fd = fd;
+    conn->eof = 0;
+    conn->dead = 0;
+    conn->out_len = 0;
+    conn->seats = SLAB_NONE;
+    conn->seat_count = 0;
+    memcpy(conn->in, data, bytes);
+    conn->in_len = bytes;
+    conn->t_recv = trace_now();
+    conn->next_sample = 0;
+    live[live_count++] = idx;
+    printf("[MUX] Connection %u joined (%d live)\n", idx, live_count);
+}
+
+// Read everything the parent has sent: connections, which carry a
+// descriptor, and verdicts, which do not. Returns -1 once the parent is gone.
+static int read_ctl(int ctl_fd)
+{
+    for (;;)
+    {
+        char data[MUX_IN_SIZE];
+        int fd;
+        int bytes = recv_fd(ctl_fd, &fd, data, sizeof(data));
+        if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+            return 0;
+        if (bytes <= 0)
+            return -1;
+
+        if (fd >= 0)
+        {
+            accept_conn(fd, data, bytes);
+        }
+        else if (bytes == sizeof(MuxVerdict))
+        {
+            MuxVerdict verdict;
+            memcpy(&verdict, data, sizeof(verdict));
+            handle_verdict(&verdict);
+        }
+    }
+}
+
+void mux_serve(int ctl_fd, const MuxConfig *mux_config)
+{
+    config = mux_config;
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    fcntl(ctl_fd, F_SETFL, fcntl(ctl_fd, F_GETFL) | O_NONBLOCK);
+    signal(SIGPIPE, SIG_IGN);   // a vanished client must not take the hub down
+
+    // Each connection costs a descriptor; take whatever the hard limit allows
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    mux_conns = slab_create(sizeof(MuxConn), MUX_MAX_CONNECTIONS, 0);
+    mux_seats = slab_create(sizeof(MuxSeat), MUX_MAX_SEATS, 0);
+    mux_games = slab_create(sizeof(MuxGame), MUX_MAX_GAMES, 0);
+    if (!mux_conns || !mux_seats || !mux_games)
+    {
+        fprintf(stderr, "[MUX] Failed to create pools\n");
+        return;
+    }
+    for (int i = 0; i < MUX_HASH_SIZE; i++)
+        buckets[i] = SLAB_NONE;
+
+    printf("[MUX] Hub ready: connection %zu bytes, seat %zu bytes, game %zu bytes\n",
+           slab_stride(mux_conns), slab_stride(mux_seats), slab_stride(mux_games));
+
+    if (config->archive_dir && config->workers > 0)
+    {
+        executor = executor_create(config->workers, config->exec_stats);
+        mux_jobs = slab_create(sizeof(ArchiveJob), config->workers * EXEC_DEQUE_SIZE, 0);
+        if (executor && mux_jobs)
+        {
+            printf("[MUX] Archiving on %d worker threads\n", config->workers);
+        }
+        else
+        {
+            printf("[MUX] No archive workers, archiving inline\n");
+            executor_destroy(executor);
+            executor = NULL;
+        }
+    }
+
+    int pending = 0;
+    for (;;)
+    {
+        pfds[0].fd = ctl_fd;
+        pfds[0].events = POLLIN;
+        for (int i = 0; i < live_count; i++)
+        {
+            MuxConn *conn = conn_at(live[i]);
+            pfds[i + 1].fd = conn->fd;
+            pfds[i + 1].events = 0;
+            if (conn->in_len < MUX_IN_SIZE && !conn->eof)
+                pfds[i + 1].events |= POLLIN;
+            if (conn->out_len > 0)
+                pfds[i + 1].events |= POLLOUT;
+        }
+        int exec_slot = live_count + 1;
+        pfds[exec_slot].fd = executor ? executor_fd(executor) : -1;
+        pfds[exec_slot].events = POLLIN;
+
+        // Events still queued for the parent are retried every millisecond
+        int n = poll(pfds, live_count + 2, pending ? 0 : outbox_len ? 1 : -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("[MUX] poll");
+            break;
+        }
+
+        // One bounded turn per connection per round
+        int polled = live_count;
+        pending = 0;
+        for (int i = 0; i < polled; i++)
+        {
+            MuxConn *conn = conn_at(live[i]);
+            short revents = pfds[i + 1].revents;
+            if (revents & (POLLIN | POLLHUP | POLLERR))
+                read_conn(conn);
+            if (revents & POLLOUT)
+                flush_conn(conn);
+            if (process_conn(live[i]))
+                pending = 1;
+        }
+
+        if (pfds[exec_slot].revents & POLLIN)
+            executor_complete(executor);
+
+        if (pfds[0].revents & (POLLIN | POLLHUP))
+        {
+            if (read_ctl(ctl_fd) < 0)
+                break;
+            pending = 1;   // new connections' first frames arrived with them
+        }
+
+        for (int i = live_count - 1; i >= 0; i--)
+        {
+            MuxConn *conn = conn_at(live[i]);
+            if (conn->dead || (conn->eof && !pending_frame(conn)))
+                close_conn(i);
+        }
+        for (int i = 0; i < live_count; i++)
+        {
+            MuxConn *conn = conn_at(live[i]);
+            if (conn->out_len > 0)
+                flush_conn(conn);
+        }
+        flush_outbox();
+        wake_parent();
+    }
+
+    free(outbox);
+
+    // Let queued archive writes finish before the hub exits
+    executor_destroy(executor);
+}
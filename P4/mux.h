@@ -0,0 +1,68 @@
+#ifndef MUX_H
+#define MUX_H
+
+#include <stdint.h>
+#include "trace.h"
+#include "executor.h"
+#include "events.h"
+#include "live.h"
+
+// Multiplexed games. A version 1 frame carries a game id right after the
+// message type (1|LL|TYPE|gid|...), so one connection can sit in many
+// games at once. All such connections are served by a single hub process.
+
+#define MUX_MAX_CONNECTIONS 1024
+#define MUX_MAX_SEATS 16384           // open game ids across all connections
+#define MUX_MAX_GAMES (MUX_MAX_SEATS / 2)   // every game holds two seats
+#define MUX_CONN_SEATS 64             // open game ids on one connection
+#define MUX_MAX_GID 999999999u
+#define MUX_FRAME_BUDGET 16           // frames per connection per poll round
+
+// Names of the players seated in the hub. The parent owns this set, like
+// every other name: the hub asks for a name (EVENT_MUX_CLAIM) before it
+// seats a player and gives it back (EVENT_MUX_RELEASE) when the seat goes.
+// Each claim has an id, so a late release cannot free a newer claim.
+typedef struct MuxNames MuxNames;
+
+MuxNames *mux_names_create(void);
+void mux_names_destroy(MuxNames *names);
+int mux_name_taken(MuxNames *names, const char *name);
+int mux_name_claim(MuxNames *names, const char *name, uint32_t seat, uint32_t claim);
+int mux_name_release(MuxNames *names, const char *name, uint32_t claim);
+void mux_names_each(MuxNames *names,
+                    void (*fn)(const char *name, uint32_t seat, uint32_t claim));
+
+// The parent's answer to a claim, sent on the handoff socket with no
+// descriptor attached
+enum {
+    MUX_GRANT = 1,
+    MUX_DENY,
+    MUX_EVICT,                  // another node won the name: forfeit the seat
+};
+
+typedef struct {
+    uint32_t op;
+    uint32_t seat;
+    uint32_t claim;
+} MuxVerdict;
+
+int mux_verdict(int ctl_fd, int op, uint32_t seat, uint32_t claim);
+
+typedef struct {
+    EventRing *events;                      // results go to the parent here
+    int wake_fd;                            // written after posting events
+    Tracer *tracer;
+    int trace_slot;
+    const char *archive_dir;                // NULL when archiving is off
+    int workers;                            // archive threads, 0 = inline
+    ExecutorStats *exec_stats;
+    LiveTable *live;                        // NULL when not publishing
+    uint32_t live_base;                     // live slot of hub game 0
+} MuxConfig;
+
+// Serve connections handed over on ctl_fd (a SOCK_SEQPACKET socket; each
+// message carries the fd and the bytes already read from it, or is a
+// MuxVerdict). Returns when the parent closes its end.
+void mux_serve(int ctl_fd, const MuxConfig *config);
+
+#endif
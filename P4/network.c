@@ -1,10 +1,16 @@
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
 #include "network.h"
 
 int connect_inet(char *host, char *service)
@@ -45,6 +51,36 @@ int connect_inet(char *host, char *service)
     return sock;
 }
 
+// Connect to a server on this host through its Unix socket
+int connect_unix(char *path)
+{
+    struct sockaddr_un addr;
+    int sock;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock == -1) {
+        perror("socket");
+        return -1;
+    }
+
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr))) {
+        perror(path);
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
 int open_listener(char *service, int queue_size)
 {
     struct addrinfo hint, *info_list, *info;
@@ -98,3 +134,138 @@ int open_listener(char *service, int queue_size)
 
     return sock;
 }
+
+// Remove path only if it is a socket nobody is listening on any more,
+// i.e. one left behind by a run that died. Anything else stays put, and
+// the caller fails with EADDRINUSE instead of deleting it.
+static int remove_stale_socket(struct sockaddr_un *addr)
+{
+    struct stat st;
+    int probe, stale;
+
+    if (lstat(addr->sun_path, &st) < 0)
+        return errno == ENOENT ? 0 : -1;
+    if (!S_ISSOCK(st.st_mode)) {
+        errno = EADDRINUSE;
+        return -1;
+    }
+
+    probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe == -1)
+        return -1;
+    stale = connect(probe, (struct sockaddr *)addr, sizeof(*addr)) < 0 && errno == ECONNREFUSED;
+    close(probe);
+    if (!stale) {
+        errno = EADDRINUSE;
+        return -1;
+    }
+    return unlink(addr->sun_path);
+}
+
+int open_unix_listener(char *path, int queue_size)
+{
+    struct sockaddr_un addr;
+    int sock;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock == -1) {
+        perror("socket");
+        return -1;
+    }
+
+    // replace a stale socket left behind by a previous run, nothing else
+    if (remove_stale_socket(&addr)) {
+        perror(path);
+        close(sock);
+        return -1;
+    }
+
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) || listen(sock, queue_size)) {
+        perror(path);
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+int send_fd(int sock, int fd, void *data, int len)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&control, 0, sizeof(control));
+    iov.iov_base = data;
+    iov.iov_len  = len;
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    // attach the descriptor as SCM_RIGHTS ancillary data
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type  = SCM_RIGHTS;
+    cmsg->cmsg_len   = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    return sendmsg(sock, &msg, 0) < 0 ? -1 : 0;
+}
+
+int recv_fd(int sock, int *fd, void *data, int len)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = data;
+    iov.iov_len  = len;
+    msg.msg_iov        = &iov;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    int bytes = recvmsg(sock, &msg, 0);
+    *fd = -1;
+    if (bytes <= 0)
+        return bytes;
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+
+    return bytes;
+}
+
+// Read a connection's TCP_INFO. Fails for sockets that are not TCP.
+int net_sample(int fd, NetSample *out)
+{
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+
+    if (fd < 0 || getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) < 0)
+        return -1;
+    out->rtt_us        = info.tcpi_rtt;
+    out->rttvar_us     = info.tcpi_rttvar;
+    out->total_retrans = info.tcpi_total_retrans;
+    out->unacked       = info.tcpi_unacked;
+    return 0;
+}
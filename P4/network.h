@@ -1,2 +1,25 @@
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include <stdint.h>
+
+// How often a game samples each player's TCP_INFO
+#define NET_SAMPLE_MS 250
+
+// Network quality of one TCP connection
+typedef struct {
+    uint32_t rtt_us;              // smoothed round-trip time
+    uint32_t rttvar_us;
+    uint32_t total_retrans;       // segments retransmitted so far
+    uint32_t unacked;             // segments in flight
+} NetSample;
+
 int connect_inet(char *host, char *service);
+int connect_unix(char *path);
 int open_listener(char *service, int queue_size);
+int open_unix_listener(char *path, int queue_size);
+int send_fd(int sock, int fd, void *data, int len);
+int recv_fd(int sock, int *fd, void *data, int len);
+int net_sample(int fd, NetSample *out);
+
+#endif
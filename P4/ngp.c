@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "ngp.h"
+
+// Split a received message into its |-separated fields. Returns the
+// number of fields; tokens[count] is NULL.
+int split_message(char *buffer, char *tokens[], int max)
+{
+    int token_count = 0;
+    tokens[token_count] = strtok(buffer, "|");
+    while (tokens[token_count] != NULL && token_count < max - 1)
+    {
+        token_count++;
+        tokens[token_count] = strtok(NULL, "|");
+    }
+    return token_count;
+}
+
+// Parse NGP messages
+int parse_messages(char *msg[], int msg_count)
+{
+    if (msg_count < 3 || strcmp(msg[0], "0") != 0)
+        return PARSE_ERROR;
+
+    if (strcmp(msg[2], "OPEN") == 0)
+    {
+        if (msg_count != 4)
+            return PARSE_ERROR;
+        if (strlen(msg[3]) > 72)
+            return PARSE_ERROR;
+        if (strchr(msg[3], '|') != NULL)
+            return PARSE_ERROR;
+        return MSG_OPEN;
+    }
+    else if (strcmp(msg[2], "PLAY") == 0)
+    {
+        if (msg_count != 5)
+            return PARSE_ERROR;
+        if (strcmp(msg[3], "1") != 0 && strcmp(msg[3], "2") != 0)
+            return PARSE_ERROR;
+        
+        int board[5];
+        int count = sscanf(msg[4], "%d %d %d %d %d",
+                           &board[0], &board[1], &board[2], &board[3], &board[4]);
+        if (count != 5)
+            return PARSE_ERROR;
+        
+        for (int i = 0; i < 5; i++)
+        {
+            if (board[i] < 0 || board[i] > 9)
+                return PARSE_ERROR;
+        }
+        return MSG_PLAY;
+    }
+    else if (strcmp(msg[2], "FAIL") == 0)
+    {
+        if (msg_count != 4)
+            return PARSE_ERROR;
+        return MSG_FAIL;
+    }
+    else if (strcmp(msg[2], "OVER") == 0)
+    {
+        if (msg_count != 6)
+            return PARSE_ERROR;
+        if (strcmp(msg[3], "1") != 0 && strcmp(msg[3], "2") != 0)
+            return PARSE_ERROR;
+        if (strcmp(msg[5], "") != 0 && strcmp(msg[5], "Forfeit") != 0)
+            return PARSE_ERROR;
+        
+        int board[5];
+        int count = sscanf(msg[4], "%d %d %d %d %d",
+                           &board[0], &board[1], &board[2], &board[3], &board[4]);
+        if (count != 5)
+            return PARSE_ERROR;
+        
+        for (int i = 0; i < 5; i++)
+        {
+            if (board[i] < 0 || board[i] > 9)
+                return PARSE_ERROR;
+        }
+        return MSG_OVER;
+    }
+    else if (strcmp(msg[2], "NAME") == 0)
+    {
+        // The resume token is an optional trailing field
+        if (msg_count != 5 && msg_count != 6)
+            return PARSE_ERROR;
+        if (strcmp(msg[3], "1") != 0 && strcmp(msg[3], "2") != 0)
+            return PARSE_ERROR;
+        if (strchr(msg[4], '|') != NULL)
+            return PARSE_ERROR;
+        return MSG_NAME;
+    }
+    else if (strcmp(msg[2], "MOVE") == 0)
+    {
+        if (msg_count != 5)
+            return PARSE_ERROR;
+        
+        // Validate pile and stones are digits
+        for (int i = 0; msg[3][i]; i++)
+        {
+            if (!isdigit(msg[3][i]))
+                return PARSE_ERROR;
+        }
+        for (int i = 0; msg[4][i]; i++)
+        {
+            if (!isdigit(msg[4][i]))
+                return PARSE_ERROR;
+        }
+        
+        // Empty or overlong numbers are malformed; a pile or quantity
+        // out of range is for the game to reject (32 or 33)
+        if (strlen(msg[3]) == 0 || strlen(msg[3]) > 2 ||
+            strlen(msg[4]) == 0 || strlen(msg[4]) > 2)
+            return PARSE_ERROR;
+        
+        return MSG_MOVE;
+    }
+    else if (strcmp(msg[2], "RSUM") == 0)
+    {
+        if (msg_count != 4)
+            return PARSE_ERROR;
+        if (strlen(msg[3]) != RESUME_TOKEN_LEN)
+            return PARSE_ERROR;
+        return MSG_RSUM;
+    }
+    else if (strcmp(msg[2], "WAIT") == 0)
+    {
+        if (msg_count != 3)
+            return PARSE_ERROR;
+        return MSG_WAIT;
+    }
+    
+    return PARSE_ERROR;
+}
+
+// Length of the version 0 frame at the start of buf (0|LL|...), 0 if it
+// has not fully arrived yet, or -1 if buf does not start with a frame
+// header
+int frame_length(const char *buf, int len)
+{
+    static const char header[] = "0|##|";
+    for (int i = 0; i < len && i < 5; i++)
+    {
+        if (header[i] == '#' ? !isdigit((unsigned char)buf[i]) : buf[i] != header[i])
+            return -1;
+    }
+    if (len < 5)
+        return 0;
+    int total = 5 + (buf[2] - '0') * 10 + (buf[3] - '0');
+    return len >= total ? total : 0;
+}
+
+// FAIL code for a lobby connection whose first message is not a usable
+// OPEN, or 0 if it is one. msg_type is parse_messages()'s verdict.
+int open_error(char *msg[], int msg_count, int msg_type)
+{
+    if (msg_type == MSG_OPEN)
+        return 0;
+    if (msg_type == MSG_MOVE)
+        return 24;
+    if (msg_count == 4 && strcmp(msg[0], "0") == 0 && strcmp(msg[2], "OPEN") == 0 &&
+        strlen(msg[3]) > 72)
+        return 21;
+    return 10;
+}
+
+// Check if board is empty (game over)
+int is_board_empty(int board[5])
+{
+    for (int i = 0; i < 5; i++)
+    {
+        if (board[i] > 0)
+            return 0;
+    }
+    return 1;
+}
+
+// Spend one message from a player's budget. Returns 0 if it is empty.
+int budget_take(MsgBudget *budget, uint64_t now)
+{
+    const uint64_t interval = 1000000000ull / NGP_RATE;
+    uint64_t full_at = budget->full_at > now ? budget->full_at : now;
+    if (full_at - now > (NGP_BURST - 1) * interval)
+        return 0;
+    budget->full_at = full_at + interval;
+    return 1;
+}
@@ -0,0 +1,38 @@
+#ifndef NGP_H
+#define NGP_H
+
+#include <stdint.h>
+
+// Nim Game Protocol message types, as returned by parse_messages()
+#define MSG_OPEN 1
+#define MSG_WAIT 2
+#define MSG_NAME 3
+#define MSG_PLAY 4
+#define MSG_MOVE 5
+#define MSG_OVER 6
+#define MSG_FAIL 7
+#define MSG_RSUM 8
+#define PARSE_ERROR -1
+
+#define MAX_NAME_LEN 73
+#define RESUME_TOKEN_LEN 16
+
+// In-game message budget per player: a token bucket that refills at
+// NGP_RATE messages a second and holds NGP_BURST. A player makes at most 13
+// moves in a game, so honest play never runs it dry however fast it is.
+// The bucket is kept as the time it will be full again (GCRA).
+#define NGP_RATE 10
+#define NGP_BURST 32
+
+typedef struct {
+    uint64_t full_at;             // nanoseconds, same clock as now
+} MsgBudget;
+
+int split_message(char *buffer, char *tokens[], int max);
+int parse_messages(char *msg[], int msg_count);
+int frame_length(const char *buf, int len);
+int open_error(char *msg[], int msg_count, int msg_type);
+int is_board_empty(int board[5]);
+int budget_take(MsgBudget *budget, uint64_t now);
+
+#endif
@@ -0,0 +1,252 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "archive.h"
+
+// Per-player totals gathered in one pass over the player columns
+typedef struct {
+    uint32_t games;
+    uint32_t wins;
+    uint32_t losses;
+    uint32_t no_result;
+    uint32_t forfeit_losses;
+    uint64_t moves;
+} PlayerTotals;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// Number of rows stored in a given block
+static uint64_t block_rows(const Archive *ar, uint64_t block)
+{
+    uint64_t start = block * ARCHIVE_BLOCK_ROWS;
+    uint64_t left = ar->rows - start;
+    return left < ARCHIVE_BLOCK_ROWS ? left : ARCHIVE_BLOCK_ROWS;
+}
+
+static uint64_t block_count(const Archive *ar)
+{
+    return (ar->rows + ARCHIVE_BLOCK_ROWS - 1) / ARCHIVE_BLOCK_ROWS;
+}
+
+// Whole-archive totals: game count, average length, forfeit rate
+static void query_summary(const Archive *ar)
+{
+    uint64_t moves = 0, forfeits = 0, duration = 0, no_result = 0;
+
+    for (uint64_t b = 0; b < block_count(ar); b++)
+    {
+        uint64_t n = block_rows(ar, b);
+        const uint8_t *nmoves = archive_column(ar, b, ARCHIVE_COL_NMOVES);
+        const uint8_t *forfeit = archive_column(ar, b, ARCHIVE_COL_FORFEIT);
+        const uint32_t *dur = archive_column(ar, b, ARCHIVE_COL_DURATION);
+        const uint8_t *winner = archive_column(ar, b, ARCHIVE_COL_WINNER);
+        for (uint64_t i = 0; i < n; i++)
+        {
+            moves += nmoves[i];
+            forfeits += forfeit[i];
+            duration += dur[i];
+            no_result += winner[i] == 0;
+        }
+    }
+
+    printf("games:         %llu\n", (unsigned long long)ar->rows);
+    printf("players:       %u\n", ar->name_count);
+    if (ar->rows == 0)
+        return;
+    printf("avg moves:     %.2f\n", (double)moves / ar->rows);
+    printf("avg duration:  %.1f ms\n", (double)duration / ar->rows);
+    printf("forfeit rate:  %.2f%%\n", 100.0 * forfeits / ar->rows);
+    printf("no result:     %llu\n", (unsigned long long)no_result);
+}
+
+// Accumulate wins, losses and forfeits for every player in one scan
+static PlayerTotals *scan_players(const Archive *ar)
+{
+    PlayerTotals *totals = calloc(ar->name_count ? ar->name_count : 1, sizeof(PlayerTotals));
+    if (!totals)
+        return NULL;
+
+    for (uint64_t b = 0; b < block_count(ar); b++)
+    {
+        uint64_t n = block_rows(ar, b);
+        const uint32_t *p1 = archive_column(ar, b, ARCHIVE_COL_P1);
+        const uint32_t *p2 = archive_column(ar, b, ARCHIVE_COL_P2);
+        const uint8_t *winner = archive_column(ar, b, ARCHIVE_COL_WINNER);
+        const uint8_t *forfeit = archive_column(ar, b, ARCHIVE_COL_FORFEIT);
+        const uint8_t *nmoves = archive_column(ar, b, ARCHIVE_COL_NMOVES);
+        for (uint64_t i = 0; i < n; i++)
+        {
+            if (p1[i] >= ar->name_count || p2[i] >= ar->name_count)
+                continue;
+            if (winner[i] == 0)
+            {
+                // No result: a game played, but neither won nor lost
+                totals[p1[i]].games++;
+                totals[p1[i]].no_result++;
+                totals[p1[i]].moves += nmoves[i];
+                totals[p2[i]].games++;
+                totals[p2[i]].no_result++;
+                totals[p2[i]].moves += nmoves[i];
+                continue;
+            }
+            PlayerTotals *w = &totals[winner[i] == 1 ? p1[i] : p2[i]];
+            PlayerTotals *l = &totals[winner[i] == 1 ? p2[i] : p1[i]];
+            w->games++;
+            w->wins++;
+            w->moves += nmoves[i];
+            l->games++;
+            l->losses++;
+            l->forfeit_losses += forfeit[i];
+            l->moves += nmoves[i];
+        }
+    }
+    return totals;
+}
+
+static void print_player(const char *name, const PlayerTotals *t)
+{
+    printf("%-24s %8u %8u %8u %9u %9.2f %8.2f%%\n", name, t->games, t->wins,
+           t->losses, t->no_result,
+           t->games ? (double)t->moves / t->games : 0.0,
+           t->games ? 100.0 * t->forfeit_losses / t->games : 0.0);
+}
+
+static void print_player_header(void)
+{
+    printf("%-24s %8s %8s %8s %9s %9s %9s\n", "player", "games", "wins", "losses",
+           "no_result", "avg_moves", "forfeit%");
+}
+
+// Totals for a single player
+static int query_player(const Archive *ar, const char *name)
+{
+    uint32_t id;
+    if (archive_find_name(ar, name, &id) < 0)
+    {
+        fprintf(stderr, "No games for player %s\n", name);
+        return 1;
+    }
+
+    PlayerTotals t;
+    memset(&t, 0, sizeof(t));
+    for (uint64_t b = 0; b < block_count(ar); b++)
+    {
+        uint64_t n = block_rows(ar, b);
+        const uint32_t *p1 = archive_column(ar, b, ARCHIVE_COL_P1);
+        const uint32_t *p2 = archive_column(ar, b, ARCHIVE_COL_P2);
+        const uint8_t *winner = archive_column(ar, b, ARCHIVE_COL_WINNER);
+        const uint8_t *forfeit = archive_column(ar, b, ARCHIVE_COL_FORFEIT);
+        const uint8_t *nmoves = archive_column(ar, b, ARCHIVE_COL_NMOVES);
+        for (uint64_t i = 0; i < n; i++)
+        {
+            int seat = p1[i] == id ? 1 : (p2[i] == id ? 2 : 0);
+            if (seat == 0)
+                continue;
+            t.games++;
+            t.moves += nmoves[i];
+            if (winner[i] == 0)
+                t.no_result++;
+            else if (winner[i] == seat)
+                t.wins++;
+            else
+            {
+                t.losses++;
+                t.forfeit_losses += forfeit[i];
+            }
+        }
+    }
+
+    print_player_header();
+    print_player(name, &t);
+    return 0;
+}
+
+static PlayerTotals *sort_totals;
+
+static int compare_games(const void *a, const void *b)
+{
+    uint32_t ga = sort_totals[*(const uint32_t *)a].games;
+    uint32_t gb = sort_totals[*(const uint32_t *)b].games;
+    return ga < gb ? 1 : (ga > gb ? -1 : 0);
+}
+
+// Per-player table, busiest players first
+static int query_players(const Archive *ar, uint32_t limit)
+{
+    PlayerTotals *totals = scan_players(ar);
+    uint32_t *order = malloc((ar->name_count ? ar->name_count : 1) * sizeof(uint32_t));
+    if (!totals || !order)
+    {
+        free(totals);
+        free(order);
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < ar->name_count; i++)
+        order[i] = i;
+    sort_totals = totals;
+    qsort(order, ar->name_count, sizeof(uint32_t), compare_games);
+
+    print_player_header();
+    for (uint32_t i = 0; i < ar->name_count && i < limit; i++)
+        print_player(archive_name(ar, order[i]), &totals[order[i]]);
+
+    free(order);
+    free(totals);
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s <archive_dir> summary\n", prog);
+    fprintf(stderr, "       %s <archive_dir> players [limit]\n", prog);
+    fprintf(stderr, "       %s <archive_dir> player <name>\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Archive ar;
+    if (archive_open(argv[1], &ar) < 0)
+        return 1;
+
+    double start = now_ms();
+    int result = 0;
+
+    if (strcmp(argv[2], "summary") == 0)
+    {
+        query_summary(&ar);
+    }
+    else if (strcmp(argv[2], "players") == 0)
+    {
+        uint32_t limit = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : 20;
+        result = query_players(&ar, limit);
+    }
+    else if (strcmp(argv[2], "player") == 0 && argc > 3)
+    {
+        result = query_player(&ar, argv[3]);
+    }
+    else
+    {
+        usage(argv[0]);
+        result = 1;
+    }
+
+    fprintf(stderr, "[nimarc] scanned %llu games in %.1f ms\n",
+            (unsigned long long)ar.rows, now_ms() - start);
+    archive_close(&ar);
+    return result;
+}
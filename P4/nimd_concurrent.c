@@ -1,435 +1,794 @@
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <unistd.h>
-#include <ctype.h>
 #include <poll.h>
 #include <sys/wait.h>
 #include <sys/mman.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#ifdef __linux__
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sched.h>
+#endif
 #include "network.h"
+#include "ngp.h"
+#include "archive.h"
+#include "stats.h"
+#include "admin.h"
+#include "trace.h"
+#include "events.h"
+#include "slab.h"
+#include "mux.h"
+#include "cluster.h"
+#include "executor.h"
+#include "game.h"
+#include "lobby.h"
 
-#define MSG_OPEN 1
-#define MSG_WAIT 2
-#define MSG_NAME 3
-#define MSG_PLAY 4
-#define MSG_MOVE 5
-#define MSG_OVER 6
-#define MSG_FAIL 7
-#define PARSE_ERROR -1
+#define MAX_GAMES (MAX_ACTIVE_PLAYERS / 2)
+#define MAX_CONNECTIONS (MAX_ACTIVE_PLAYERS + 2)
+#define MAX_LISTENERS 2
 
-#define MAX_ACTIVE_PLAYERS 100
-#define MAX_NAME_LEN 73
+// Latency histogram slots: one per game, then finished games, the lobby
+// and the multiplexing hub
+#define TRACE_RETIRED_SLOT MAX_GAMES
+#define TRACE_LOBBY_SLOT (MAX_GAMES + 1)
+#define TRACE_MUX_SLOT (MAX_GAMES + 2)
+#define TRACE_SLOTS (MAX_GAMES + 3)
+#define DEFAULT_TRACE_SAMPLE 100
 
-// Shared memory structure for tracking active players
-typedef struct {
-    char names[MAX_ACTIVE_PLAYERS][MAX_NAME_LEN];
-    int count;
-} ActivePlayers;
+// Each game has at most three events outstanding (started, finished,
+// exited), so the ring can never fill while games are bounded by MAX_GAMES
+#define EVENT_RING_SIZE 1024
 
-ActivePlayers *active_players;
+// The hub holds back what does not fit in its ring and retries
+#define HUB_EVENT_RING_SIZE 4096
 
-// Parse NGP messages
-int parse_messages(char *msg[], int msg_count)
+// Child exits the SIGCHLD handler could not push to the ring. Every child
+// (the games, the admin server and the hub) exits once and is only
+// replaced after its exit is drained, so this cannot fill either.
+#define EXIT_OVERFLOW_SIZE (MAX_GAMES + 2)
+
+// Lifetime player records and leaderboard, shared with the admin process
+StatsTable *player_stats;
+
+// Sampled trace events are written here on a stats dump, if set
+char *trace_path = NULL;
+volatile sig_atomic_t dump_requested = 0;
+
+// Exits the SIGCHLD handler holds for drain_events() when the event ring
+// is full. Only the handler adds to it; the lobby empties it with SIGCHLD
+// blocked. reap_pending is set if a child was left unreaped for lack of
+// room.
+struct {
+    pid_t pid;
+    int status;
+} exit_overflow[EXIT_OVERFLOW_SIZE];
+volatile sig_atomic_t exit_overflow_count = 0;
+volatile sig_atomic_t reap_pending = 0;
+
+// Sockets the lobby accepts players on: the TCP port, a Unix socket path
+// (-U), or both. Everything after accept() is the same for either.
+// The slot after the last listener holds the wake pipe.
+struct pollfd listeners[MAX_LISTENERS + 1];
+int listener_count = 0;
+char *unix_path = NULL;
+
+// Self-pipe: the signal handlers write a byte to it, so a lobby about to
+// block in poll() still wakes for a signal that landed while it was busy
+int wake_pipe[2] = { -1, -1 };
+
+// File the live game table is mapped from (-L), or NULL
+char *live_path = NULL;
+LiveTable live_games;
+
+// Parent's end of each game's resume channel, by game index (parent only)
+int game_ctl[MAX_GAMES];
+
+// Parent's end of the hub's handoff channel, -1 unless -m was given
+int mux_ctl = -1;
+
+// Events from the hub. They have a ring of their own, so a busy hub can
+// never crowd out the game processes' events.
+EventRing *hub_events = NULL;
+
+// Archive threads in the hub, and their counters (shared with the hub)
+int mux_workers = 2;
+ExecutorStats *mux_exec_stats = NULL;
+
+// With the cluster name registry (-C), SIGUSR2 means a name was lost to
+// another node: the parent finds the games holding it, and a game process
+// checks whether it has players to evict.
+volatile sig_atomic_t cluster_check = 0;
+
+// With -b, game processes are pinned to these CPUs, round robin by game
+int game_cpus[CPU_SETSIZE];
+int game_cpu_count = 0;
+
+// Release a game and both of its connections
+void game_free(slab_idx idx)
 {
-    if (strcmp(msg[0], "0") != 0)
-        return PARSE_ERROR;
+    Game *game = slab_get(game_pool, idx);
+    game->pid = 0;
+    memset(game->tokens, 0, sizeof(game->tokens));
+    if (idx < MAX_GAMES && game_ctl[idx] >= 0)
+    {
+        close(game_ctl[idx]);
+        game_ctl[idx] = -1;
+    }
+    if (live_table)
+        live_clear(live_table, idx);   // in case the game process died
+    conn_free(game->players[0]);
+    conn_free(game->players[1]);
+    slab_free(game_pool, idx);
+}
 
-    if (strcmp(msg[2], "OPEN") == 0)
+// Read a complete NGP message with non-blocking poll
+int read_message(int fd, char *buffer, int buffer_size, int timeout_ms)
+{
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    
+    int result = poll(&pfd, 1, timeout_ms);
+    if (result <= 0)
+        return result; // timeout or error
+    
+    if (pfd.revents & POLLIN)
     {
-        if (msg_count != 4)
-            return PARSE_ERROR;
-        if (strlen(msg[3]) > 72)
-            return PARSE_ERROR;
-        if (strchr(msg[3], '|') != NULL)
-            return PARSE_ERROR;
-        return MSG_OPEN;
+        int bytes = read(fd, buffer, buffer_size - 1);
+        if (bytes > 0)
+            buffer[bytes] = '\0';
+        return bytes;
     }
-    else if (strcmp(msg[2], "PLAY") == 0)
+    
+    return 0;
+}
+
+// Pin a game process to one of the allowed CPUs, round robin by game
+void pin_game(slab_idx game_idx)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(game_cpus[game_idx % game_cpu_count], &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0)
+        perror("sched_setaffinity");
+}
+
+// Add a finished game process's CPU time and lifetime to wait_stats
+void account_game(uint64_t started)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    uint64_t cpu = (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ull +
+                   (uint64_t)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ull;
+    __atomic_fetch_add(&wait_stats->games, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&wait_stats->cpu_ns, cpu, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&wait_stats->wall_ns, trace_now() - started, __ATOMIC_RELAXED);
+}
+
+// Wake the lobby if it is blocked in poll(); safe in a signal handler
+void wake_lobby(void)
+{
+    int saved_errno = errno;
+    if (wake_pipe[1] >= 0 && write(wake_pipe[1], "", 1) < 0)
+        ;   // full pipe: a wakeup is already pending
+    errno = saved_errno;
+}
+
+// Ask the lobby loop to dump latency stats
+void sigusr1_handler(int sig)
+{
+    (void)sig;
+    dump_requested = 1;
+    wake_lobby();
+}
+
+// Print the latency histograms, and write the sampled trace if enabled
+void dump_stats(void)
+{
+    static const struct { const char *label; int first; int count; } groups[] = {
+        { "lobby", TRACE_LOBBY_SLOT, 1 },
+        { "game", 0, MAX_GAMES + 1 },   // live games plus finished ones
+        { "mux", TRACE_MUX_SLOT, 1 },
+    };
+    Histogram hist;
+
+    dump_requested = 0;
+    printf("[STATS] %-6s %-15s %9s %9s %9s %9s %9s %9s %9s\n", "proc", "span",
+           "count", "min_us", "p50_us", "p90_us", "p99_us", "p999_us", "max_us");
+    for (size_t g = 0; g < sizeof(groups) / sizeof(groups[0]); g++)
     {
-        if (msg_count != 5)
-            return PARSE_ERROR;
-        if (strcmp(msg[3], "1") != 0 && strcmp(msg[3], "2") != 0)
-            return PARSE_ERROR;
-        
-        int board[5];
-        int count = sscanf(msg[4], "%d %d %d %d %d",
-                           &board[0], &board[1], &board[2], &board[3], &board[4]);
-        if (count != 5)
-            return PARSE_ERROR;
-        
-        for (int i = 0; i < 5; i++)
+        for (int span = 0; span < SPAN_COUNT; span++)
         {
-            if (board[i] < 0 || board[i] > 9)
-                return PARSE_ERROR;
+            trace_sum(tracer, groups[g].first, groups[g].count, span, &hist);
+            if (hist.count == 0)
+                continue;
+            printf("[STATS] %-6s %-15s %9llu %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+                   groups[g].label, trace_span_name(span), (unsigned long long)hist.count,
+                   hist.min / 1000.0, hist_percentile(&hist, 50) / 1000.0,
+                   hist_percentile(&hist, 90) / 1000.0, hist_percentile(&hist, 99) / 1000.0,
+                   hist_percentile(&hist, 99.9) / 1000.0, hist.max / 1000.0);
         }
-        return MSG_PLAY;
     }
-    else if (strcmp(msg[2], "FAIL") == 0)
+
+    uint64_t hits = __atomic_load_n(&wait_stats->spin_hits, __ATOMIC_RELAXED);
+    uint64_t misses = __atomic_load_n(&wait_stats->spin_misses, __ATOMIC_RELAXED);
+    uint64_t games = __atomic_load_n(&wait_stats->games, __ATOMIC_RELAXED);
+    uint64_t cpu_ns = __atomic_load_n(&wait_stats->cpu_ns, __ATOMIC_RELAXED);
+    uint64_t wall_ns = __atomic_load_n(&wait_stats->wall_ns, __ATOMIC_RELAXED);
+    if (busy_poll_usec > 0)
     {
-        if (msg_count != 4)
-            return PARSE_ERROR;
-        return MSG_FAIL;
+        printf("[STATS] busy-poll %d us: %llu waits ended spinning, %llu slept (%.1f%% hit), "
+               "%.1f ms spent spinning\n", busy_poll_usec, (unsigned long long)hits,
+               (unsigned long long)misses, hits + misses ? 100.0 * hits / (hits + misses) : 0.0,
+               __atomic_load_n(&wait_stats->spin_ns, __ATOMIC_RELAXED) / 1e6);
     }
-    else if (strcmp(msg[2], "OVER") == 0)
+    printf("[STATS] game cpu %.1f ms over %.1f s of %llu finished games (%.2f%% of a core each)\n",
+           cpu_ns / 1e6, wall_ns / 1e9, (unsigned long long)games,
+           wall_ns ? 100.0 * cpu_ns / wall_ns : 0.0);
+
+    uint64_t net_games = __atomic_load_n(&net_stats->games, __ATOMIC_RELAXED);
+    printf("[STATS] net %llu samples, %llu finished games: %llu retransmits, %llu games with any, "
+           "%u segments unacked at most\n",
+           (unsigned long long)__atomic_load_n(&net_stats->samples, __ATOMIC_RELAXED),
+           (unsigned long long)net_games,
+           (unsigned long long)__atomic_load_n(&net_stats->retrans, __ATOMIC_RELAXED),
+           (unsigned long long)__atomic_load_n(&net_stats->lossy_games, __ATOMIC_RELAXED),
+           __atomic_load_n(&net_stats->unacked_max, __ATOMIC_RELAXED));
+
+    // Archive writes the hub handed to its worker threads
+    if (mux_exec_stats && mux_exec_stats->workers > 0)
     {
-        if (msg_count != 6)
-            return PARSE_ERROR;
-        if (strcmp(msg[3], "1") != 0 && strcmp(msg[3], "2") != 0)
-            return PARSE_ERROR;
-        if (strcmp(msg[5], "") != 0 && strcmp(msg[5], "Forfeit") != 0)
-            return PARSE_ERROR;
-        
-        int board[5];
-        int count = sscanf(msg[4], "%d %d %d %d %d",
-                           &board[0], &board[1], &board[2], &board[3], &board[4]);
-        if (count != 5)
-            return PARSE_ERROR;
-        
-        for (int i = 0; i < 5; i++)
-        {
-            if (board[i] < 0 || board[i] > 9)
-                return PARSE_ERROR;
-        }
-        return MSG_OVER;
+        ExecutorStats *es = mux_exec_stats;
+        uint64_t done = __atomic_load_n(&es->completed, __ATOMIC_RELAXED);
+        uint64_t steals = __atomic_load_n(&es->steals, __ATOMIC_RELAXED);
+        printf("[STATS] mux executor %u workers: %llu tasks done, %llu stolen (%.1f%%), "
+               "%llu ran inline (queues full)\n", es->workers, (unsigned long long)done,
+               (unsigned long long)steals, done ? 100.0 * steals / done : 0.0,
+               (unsigned long long)__atomic_load_n(&es->rejected, __ATOMIC_RELAXED));
+        printf("[STATS] mux executor queue delay p50 %.1f p99 %.1f max %.1f us, "
+               "run p50 %.1f p99 %.1f max %.1f us\n",
+               hist_percentile(&es->queue_delay, 50) / 1000.0,
+               hist_percentile(&es->queue_delay, 99) / 1000.0, es->queue_delay.max / 1000.0,
+               hist_percentile(&es->run_time, 50) / 1000.0,
+               hist_percentile(&es->run_time, 99) / 1000.0, es->run_time.max / 1000.0);
     }
-    else if (strcmp(msg[2], "NAME") == 0)
+
+    if (cluster)
     {
-        if (msg_count != 5)
-            return PARSE_ERROR;
-        if (strcmp(msg[3], "1") != 0 && strcmp(msg[3], "2") != 0)
-            return PARSE_ERROR;
-        if (strchr(msg[4], '|') != NULL)
-            return PARSE_ERROR;
-        return MSG_NAME;
+        ClusterStats cs;
+        cluster_stats(cluster, &cs);
+        printf("[STATS] cluster node %08x: %u remote names, sent %llu claims in %llu batches, "
+               "received %llu, conflicts won %llu lost %llu\n",
+               cs.node_id, cs.remote_names, (unsigned long long)cs.claims_sent,
+               (unsigned long long)cs.batches_sent, (unsigned long long)cs.claims_received,
+               (unsigned long long)cs.conflicts_won, (unsigned long long)cs.conflicts_lost);
     }
-    else if (strcmp(msg[2], "MOVE") == 0)
+
+    if (trace_path)
     {
-        if (msg_count != 5)
-            return PARSE_ERROR;
-        
-        // Validate pile and stones are digits
-        for (int i = 0; msg[3][i]; i++)
+        FILE *out = fopen(trace_path, "w");
+        if (out)
         {
-            if (!isdigit(msg[3][i]))
-                return PARSE_ERROR;
+            int events = trace_write_json(tracer, out);
+            fclose(out);
+            printf("[STATS] Wrote %d trace events to %s\n", events, trace_path);
         }
-        for (int i = 0; msg[4][i]; i++)
+        else
         {
-            if (!isdigit(msg[4][i]))
-                return PARSE_ERROR;
+            perror(trace_path);
         }
-        
-        int pile = atoi(msg[3]);
-        int stones = atoi(msg[4]);
-        
-        if (pile < 0 || pile > 4)
-            return PARSE_ERROR;
-        if (stones <= 0)
-            return PARSE_ERROR;
-        
-        return MSG_MOVE;
     }
-    else if (strcmp(msg[2], "WAIT") == 0)
+    fflush(stdout);
+}
+
+void sigusr2_handler(int sig)
+{
+    (void)sig;
+    cluster_check = 1;
+    wake_lobby();
+}
+
+// Have the hub forfeit a seat whose name another node won
+void evict_hub_seat(const char *name, uint32_t seat, uint32_t claim)
+{
+    if (!cluster_name_taken(cluster, name))
+        return;
+    printf("[SERVER] Hub seat for %s holds a name won by another node, evicting\n", name);
+    if (mux_verdict(mux_ctl, MUX_EVICT, seat, claim) < 0)
+        perror("mux verdict failed");
+}
+
+// Evict players whose names another node won. The game process forfeits
+// them when SIGUSR2 interrupts its poll(); the hub, when its eviction
+// arrives on the handoff socket.
+void evict_lost_names(void)
+{
+    cluster_check = 0;
+    if (mux_names)
+        mux_names_each(mux_names, evict_hub_seat);
+    for (slab_idx i = 0; i < slab_capacity(game_pool); i++)
     {
-        if (msg_count != 3)
-            return PARSE_ERROR;
-        return MSG_WAIT;
+        Game *game = slab_get(game_pool, i);
+        if (game->pid <= 0 || !game->registered || game->evict)
+            continue;
+
+        int evict = 0;
+        for (int p = 0; p < 2; p++)
+        {
+            if (cluster_name_taken(cluster, conn_get(game->players[p])->name))
+                evict |= 1 << p;
+        }
+        if (!evict)
+            continue;
+
+        printf("[SERVER] Game %u holds a name won by another node, evicting\n", i);
+        __atomic_store_n(&game->evict, evict, __ATOMIC_RELEASE);
+        kill(game->pid, SIGUSR2);
     }
-    
-    return PARSE_ERROR;
 }
 
-// Check if player name is already active
-int is_player_active(const char *name)
+// Find the game run by a given process
+slab_idx find_game_by_pid(pid_t pid)
 {
-    for (int i = 0; i < active_players->count; i++)
+    for (slab_idx i = 0; i < slab_capacity(game_pool); i++)
     {
-        if (strcmp(active_players->names[i], name) == 0)
-            return 1;
+        Game *game = slab_get(game_pool, i);
+        if (game->pid == pid)
+            return i;
+    }
+    return SLAB_NONE;
+}
+
+// Take a finished game's players out of ActivePlayers
+void unregister_players(Game *game)
+{
+    if (!game->registered)
+        return;
+    remove_active_player(conn_get(game->players[0])->name);
+    remove_active_player(conn_get(game->players[1])->name);
+    game->registered = 0;
+}
+
+// Apply what the hub has reported on its own ring
+void drain_hub_events(void)
+{
+    GameEvent event;
+    while (events_pop(hub_events, &event) == 0)
+    {
+        if (event.type == EVENT_MUX_CLAIM)
+        {
+            // The hub seats nobody until the name is granted here, where
+            // every other name is checked and claimed too
+            int op = MUX_GRANT;
+            if (is_player_active(event.names[0]) ||
+                mux_name_claim(mux_names, event.names[0], event.game, event.claim) < 0)
+                op = MUX_DENY;
+            else if (cluster)
+                cluster_claim(cluster, event.names[0]);
+            if (mux_verdict(mux_ctl, op, event.game, event.claim) < 0)
+                perror("mux verdict failed");
+        }
+        else if (event.type == EVENT_MUX_RELEASE)
+        {
+            if (mux_name_release(mux_names, event.names[0], event.claim) == 0 && cluster)
+                cluster_release(cluster, event.names[0]);
+        }
+        else if (event.type == EVENT_MUX_FINISHED)
+        {
+            // The hub has already logged the game
+            const char *winner = event.names[event.winner - 1];
+            const char *loser = event.names[2 - event.winner];
+            if (stats_record_game(player_stats, winner, loser, event.forfeit, time(NULL)) < 0)
+                printf("[SERVER] Stats table full, hub result not counted\n");
+        }
     }
-    return 0;
 }
 
-// Add player to active list
-void add_active_player(const char *name)
+// Release the game run by a child process that has been reaped
+void child_exited(pid_t pid, int status)
 {
-    if (active_players->count < MAX_ACTIVE_PLAYERS)
+    slab_idx idx = find_game_by_pid(pid);
+    if (idx == SLAB_NONE)
+        return;   // not a game process (e.g. the admin server)
+
+    Game *game = slab_get(game_pool, idx);
+    if (game->registered)
     {
-        strncpy(active_players->names[active_players->count], name, MAX_NAME_LEN - 1);
-        active_players->names[active_players->count][MAX_NAME_LEN - 1] = '\0';
-        active_players->count++;
+        // The game never reported a result
+        if (WIFSIGNALED(status))
+            printf("[SERVER] Game process %d killed by signal %d\n", pid, WTERMSIG(status));
+        else
+            printf("[SERVER] Game process %d exited without a result (status %d)\n",
+                   pid, WEXITSTATUS(status));
+        unregister_players(game);
     }
+    game_free(idx);
+}
+
+// Handle the exits the SIGCHLD handler could not fit in the ring. Exits
+// are drained after the ring, so a game's result is always seen first.
+void drain_exit_overflow(void)
+{
+    if (exit_overflow_count == 0 && !reap_pending)
+        return;
+
+    sigset_t chld_mask, old_mask;
+    sigemptyset(&chld_mask);
+    sigaddset(&chld_mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld_mask, &old_mask);
+    int count = exit_overflow_count;
+    pid_t pids[EXIT_OVERFLOW_SIZE];
+    int statuses[EXIT_OVERFLOW_SIZE];
+    for (int i = 0; i < count; i++)
+    {
+        pids[i] = exit_overflow[i].pid;
+        statuses[i] = exit_overflow[i].status;
+    }
+    exit_overflow_count = 0;
+    int reap = reap_pending;
+    reap_pending = 0;
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+
+    for (int i = 0; i < count; i++)
+        child_exited(pids[i], statuses[i]);
+
+    // Children left unreaped while the overflow was full send no second
+    // SIGCHLD, so reap them now
+    if (reap)
+        raise(SIGCHLD);
 }
 
-// Remove player from active list
-void remove_active_player(const char *name)
+// Apply everything the game processes and the hub have reported. Only the
+// parent touches ActivePlayers and the stats table, so no other process
+// contends.
+void drain_events(void)
 {
-    for (int i = 0; i < active_players->count; i++)
+    GameEvent event;
+    if (hub_events)
+        drain_hub_events();
+    while (events_pop(game_events, &event) == 0)
     {
-        if (strcmp(active_players->names[i], name) == 0)
+        if (event.type == EVENT_CHILD_EXITED)
         {
-            // Shift remaining players down
-            for (int j = i; j < active_players->count - 1; j++)
+            child_exited(event.pid, event.status);
+            continue;
+        }
+
+        if (event.game >= slab_capacity(game_pool))
+            continue;
+        Game *game = slab_get(game_pool, event.game);
+        if (game->pid != event.pid)
+            continue;   // stale event for a slot that has been reused
+
+        if (event.type == EVENT_GAME_STARTED)
+        {
+            printf("[SERVER] Game %u started (PID: %d)\n", event.game, event.pid);
+        }
+        else if (event.type == EVENT_GAME_FINISHED)
+        {
+            const char *p1_name = conn_get(game->players[0])->name;
+            const char *p2_name = conn_get(game->players[1])->name;
+
+            if (event.winner == 1 || event.winner == 2)
             {
-                strcpy(active_players->names[j], active_players->names[j + 1]);
+                const char *winner = event.winner == 1 ? p1_name : p2_name;
+                const char *loser = event.winner == 1 ? p2_name : p1_name;
+                printf("[SERVER] Game %u over: %s beat %s%s in %u moves, %u ms "
+                       "(rtt %.2f/%.2f ms, %u/%u retransmits)\n",
+                       event.game, winner, loser, event.forfeit ? " by forfeit" : "",
+                       event.moves, event.duration_ms, event.rtt_us[0] / 1000.0,
+                       event.rtt_us[1] / 1000.0, event.retrans[0], event.retrans[1]);
+                if (stats_record_game(player_stats, winner, loser, event.forfeit, time(NULL)) < 0)
+                    printf("[SERVER] Stats table full, result not counted\n");
             }
-            active_players->count--;
-            break;
+            else
+            {
+                printf("[SERVER] Game %u ended without a winner\n", event.game);
+            }
+            unregister_players(game);
         }
     }
+    drain_exit_overflow();
 }
 
-// Send a formatted NGP message
-void send_message(int fd, const char *format, ...)
+// Catch up on game events and any pending stats dump. The wake pipe is
+// emptied first, so a signal arriving after that leaves a byte behind and
+// the next poll() returns at once.
+void service_events(void)
 {
-    char content[1024];
-    va_list args;
-    va_start(args, format);
-    vsnprintf(content, sizeof(content), format, args);
-    va_end(args);
-    
-    int content_len = strlen(content);
-    char full_msg[1124];
-    snprintf(full_msg, sizeof(full_msg), "0|%02d|%s", content_len, content);
-    
-    write(fd, full_msg, strlen(full_msg));
+    char drain[64];
+    while (read(wake_pipe[0], drain, sizeof(drain)) > 0)
+        ;
+    drain_events();
+    if (dump_requested)
+        dump_stats();
+    if (cluster_check)
+        evict_lost_names();
 }
 
-// Check if board is empty (game over)
-int is_board_empty(int board[5])
+// Read from a lobby socket, handling game events and signals while the
+// client has not sent anything yet
+int read_socket(int fd, char *buffer, int size)
 {
-    for (int i = 0; i < 5; i++)
+    struct pollfd fds[2] = {
+        { .fd = fd, .events = POLLIN },
+        { .fd = wake_pipe[0], .events = POLLIN },
+    };
+    for (;;)
     {
-        if (board[i] > 0)
-            return 0;
+        service_events();
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno != EINTR)
+                return -1;
+            continue;
+        }
+        if (!fds[0].revents)
+            continue;
+        int bytes = read(fd, buffer, size);
+        if (bytes >= 0 || errno != EINTR)
+            return bytes;
     }
-    return 1;
 }
 
-// Read a complete NGP message with non-blocking poll
-int read_message(int fd, char *buffer, int buffer_size, int timeout_ms)
+// Handle child process termination by passing the exit status to the
+// lobby loop; the parent releases the game when it drains the event
+void sigchld_handler(int sig)
 {
-    struct pollfd pfd;
-    pfd.fd = fd;
-    pfd.events = POLLIN;
-    
-    int result = poll(&pfd, 1, timeout_ms);
-    if (result <= 0)
-        return result; // timeout or error
-    
-    if (pfd.revents & POLLIN)
+    (void)sig;
+    int saved_errno = errno;
+    pid_t pid;
+    int status;
+    while (exit_overflow_count < EXIT_OVERFLOW_SIZE &&
+           (pid = waitpid(-1, &status, WNOHANG)) > 0)
     {
-        int bytes = read(fd, buffer, buffer_size - 1);
-        if (bytes > 0)
-            buffer[bytes] = '\0';
-        return bytes;
+        GameEvent event;
+        memset(&event, 0, sizeof(event));
+        event.type = EVENT_CHILD_EXITED;
+        event.pid = pid;
+        event.status = status;
+        if (events_push(game_events, &event) < 0)
+        {
+            // Ring full: the child is reaped, so its exit must not be lost
+            exit_overflow[exit_overflow_count].pid = pid;
+            exit_overflow[exit_overflow_count].status = status;
+            exit_overflow_count++;
+        }
     }
-    
-    return 0;
+    if (exit_overflow_count == EXIT_OVERFLOW_SIZE)
+        reap_pending = 1;
+    errno = saved_errno;
+    wake_lobby();
 }
 
-// Handle a complete game between two players
-void handle_game(int p1_fd, int p2_fd, char *p1_name, char *p2_name)
+// Fill in a random resume token of RESUME_TOKEN_LEN hex digits
+void make_token(char *token)
 {
-    printf("[GAME] Starting game: %s vs %s\n", p1_name, p2_name);
-    
-    // Add both players to active list
-    add_active_player(p1_name);
-    add_active_player(p2_name);
-    
-    // Send NAME messages
-    send_message(p1_fd, "NAME|1|%s|", p2_name);
-    send_message(p2_fd, "NAME|2|%s|", p1_name);
-    
-    printf("[GAME] Sent NAME messages\n");
-    
-    // Initialize game board
-    int game_board[5] = {1, 3, 5, 7, 9};
-    int current_player = 1;
-    int other_player = 2;
-    int current_fd = p1_fd;
-    int other_fd = p2_fd;
-    
-    struct pollfd pfds[2];
-    pfds[0].fd = p1_fd;
-    pfds[0].events = POLLIN;
-    pfds[1].fd = p2_fd;
-    pfds[1].events = POLLIN;
-    
-    while (!is_board_empty(game_board))
+    unsigned char raw[RESUME_TOKEN_LEN / 2];
+    if (getentropy(raw, sizeof(raw)) < 0)
     {
-        // Send PLAY message to both players
-        char board_str[50];
-        snprintf(board_str, sizeof(board_str), "%d %d %d %d %d",
-                 game_board[0], game_board[1], game_board[2], 
-                 game_board[3], game_board[4]);
-        
-        send_message(p1_fd, "PLAY|%d|%s|", current_player, board_str);
-        send_message(p2_fd, "PLAY|%d|%s|", current_player, board_str);
-        
-        printf("[GAME] Sent PLAY - Player %d's turn. Board: %s\n", 
-               current_player, board_str);
-        
-        // Wait for messages from either player (EXTRA CREDIT)
-        int poll_result = poll(pfds, 2, -1);
-        
-        if (poll_result < 0)
+        // No entropy source; fall back to something unguessable enough
+        uint64_t seed = trace_now() ^ ((uint64_t)getpid() << 32);
+        for (size_t i = 0; i < sizeof(raw); i++)
         {
-            perror("poll error");
-            break;
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            raw[i] = seed >> 56;
         }
+    }
+    for (size_t i = 0; i < sizeof(raw); i++)
+        snprintf(token + 2 * i, 3, "%02x", raw[i]);
+}
+
+// Hand a reconnected socket to the game process holding its seat. The
+// game may run in any process; the parent routes by token.
+void resume_session(int fd, const char *token)
+{
+    drain_events();
+    for (slab_idx i = 0; i < slab_capacity(game_pool); i++)
+    {
+        Game *game = slab_get(game_pool, i);
+        if (game->pid <= 0 || !game->registered || game_ctl[i] < 0)
+            continue;
+
+        for (int player = 1; player <= 2; player++)
+        {
+            if (strcmp(game->tokens[player - 1], token) != 0)
+                continue;
+
+            if (send_fd(game_ctl[i], fd, &player, sizeof(player)) < 0)
+                perror("resume handoff failed");
+            else
+                printf("[SERVER] Routed resume for Player %d to game %u\n", player, i);
+            close(fd);
+            return;
+        }
+    }
+
+    printf("[SERVER] Rejected resume with unknown token\n");
+    send_message(fd, "FAIL|24 Not Playing|");
+    close(fd);
+}
+
+// Close the listening sockets (and the wake pipe's read end) in a
+// process that is not the lobby
+void close_listeners(void)
+{
+    for (int i = 0; i < listener_count; i++)
+        close(listeners[i].fd);
+    close(wake_pipe[0]);
+}
+
+// Wait for a connection on any listener, handling game events meanwhile.
+// Events are serviced on every pass before blocking, and the wake pipe is
+// polled with the listeners, so no signal waits for the next connection.
+// The listeners are non-blocking, so a connection that went away between
+// poll() and accept() does not stall the lobby.
+int accept_client(void)
+{
+    for (;;)
+    {
+        service_events();
+        if (poll(listeners, listener_count + 1, -1) < 0)
+        {
+            if (errno != EINTR)
+                perror("poll");
+            continue;
+        }
+        for (int i = 0; i < listener_count; i++)
+        {
+            if (!(listeners[i].revents & POLLIN))
+                continue;
+            int fd = accept(listeners[i].fd, NULL, NULL);
+            if (fd >= 0)
+                return fd;
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                perror("accept");
+        }
+    }
+}
+
+// Accept connections until one sends a valid OPEN for a name that is not
+// already playing (or equal to taken, the player already waiting). Resume
+// requests arriving meanwhile are routed to their games.
+slab_idx accept_player(int number, const char *taken, uint64_t *t_recv, uint64_t *t_valid)
+{
+    for (;;)
+    {
+        printf("[SERVER] Waiting for Player %d...\n", number);
+        int fd = accept_client();
+        printf("[SERVER] Player %d connected\n", number);
+
+        slab_idx idx = conn_alloc(fd);
+        if (idx == SLAB_NONE)
+        {
+            printf("[SERVER] Connection pool exhausted, dropping Player %d\n", number);
+            close(fd);
+            continue;
+        }
+        Connection *conn = conn_get(idx);
         
-        // Check if non-current player sent a message (impatient)
-        if (pfds[other_player - 1].revents & POLLIN)
+        // Get the player's name
+        char *buffer = conn_buffer(conn);
+        int bytes = read_socket(fd, buffer, BUFFER_SIZE - 1);
+        *t_recv = trace_now();
+        if (bytes <= 0)
         {
-            char buffer[1024];
-            int bytes = read(pfds[other_player - 1].fd, buffer, sizeof(buffer) - 1);
-            
-            if (bytes <= 0)
+            close(fd);
+            conn_free(idx);
+            continue;
+        }
+        buffer[bytes] = '\0';
+
+        // A version 1 frame opts in to multiplexing; the hub takes the
+        // connection along with whatever it has sent so far
+        if (mux_ctl >= 0 && buffer[0] == '1' && buffer[1] == '|')
+        {
+            if (send_fd(mux_ctl, fd, buffer, bytes) < 0)
             {
-                // Other player disconnected - current player wins by forfeit
-                printf("[GAME] Player %d disconnected. Player %d wins by forfeit!\n",
-                       other_player, current_player);
-                
-                snprintf(board_str, sizeof(board_str), "%d %d %d %d %d",
-                         game_board[0], game_board[1], game_board[2],
-                         game_board[3], game_board[4]);
-                send_message(current_fd, "OVER|%d|%s|Forfeit|", current_player, board_str);
-                
-                remove_active_player(p1_name);
-                remove_active_player(p2_name);
-                return;
+                perror("mux handoff failed");
+                send_message(fd, "FAIL|10 Invalid|");
             }
-            
-            // Player sent message when not their turn - Impatient
-            printf("[GAME] Player %d sent message out of turn (Impatient)\n", other_player);
-            send_message(pfds[other_player - 1].fd, "FAIL|31 Impatient|");
-            // Continue waiting for correct player
+            close(fd);
+            conn_free(idx);
             continue;
         }
         
-        // Check if current player sent a message or disconnected
-        if (pfds[current_player - 1].revents & POLLIN)
+        // The name is checked against everything the parent has heard
+        drain_events();
+        const char *token;
+        int admitted = lobby_admit(idx, taken, &token);
+        if (admitted == LOBBY_RESUME)
         {
-            char buffer[1024];
-            int bytes = read(current_fd, buffer, sizeof(buffer) - 1);
-            
-            if (bytes <= 0)
-            {
-                // Current player disconnected - other player wins by forfeit
-                printf("[GAME] Player %d disconnected. Player %d wins by forfeit!\n",
-                       current_player, other_player);
-                
-                snprintf(board_str, sizeof(board_str), "%d %d %d %d %d",
-                         game_board[0], game_board[1], game_board[2],
-                         game_board[3], game_board[4]);
-                send_message(other_fd, "OVER|%d|%s|Forfeit|", other_player, board_str);
-                
-                remove_active_player(p1_name);
-                remove_active_player(p2_name);
-                return;
-            }
-            
-            buffer[bytes] = '\0';
-            
-            // Parse the MOVE message
-            char *tokens[20];
-            int token_count = 0;
-            tokens[token_count] = strtok(buffer, "|");
-            while (tokens[token_count] != NULL && token_count < 19)
-            {
-                token_count++;
-                tokens[token_count] = strtok(NULL, "|");
-            }
-            
-            int msg_type = parse_messages(tokens, token_count);
-            
-            if (msg_type == MSG_MOVE)
-            {
-                int pile = atoi(tokens[3]);
-                int stones = atoi(tokens[4]);
-                
-                // Validate move
-                if (pile < 0 || pile > 4)
-                {
-                    send_message(current_fd, "FAIL|32 Pile Index|");
-                    continue;
-                }
-                
-                if (stones <= 0 || stones > game_board[pile])
-                {
-                    send_message(current_fd, "FAIL|33 Quantity|");
-                    continue;
-                }
-                
-                // Execute move
-                game_board[pile] -= stones;
-                printf("[GAME] Player %d removed %d stones from pile %d\n",
-                       current_player, stones, pile);
-                
-                // Check if game is over
-                if (is_board_empty(game_board))
-                {
-                    // Current player wins (took last stone)
-                    snprintf(board_str, sizeof(board_str), "%d %d %d %d %d",
-                             game_board[0], game_board[1], game_board[2],
-                             game_board[3], game_board[4]);
-                    
-                    send_message(p1_fd, "OVER|%d|%s||", current_player, board_str);
-                    send_message(p2_fd, "OVER|%d|%s||", current_player, board_str);
-                    
-                    printf("[GAME] Game over! Player %d (%s) wins!\n",
-                           current_player, current_player == 1 ? p1_name : p2_name);
-                    break;
-                }
-                
-                // Switch turns
-                int temp = current_player;
-                current_player = other_player;
-                other_player = temp;
-                
-                int temp_fd = current_fd;
-                current_fd = other_fd;
-                other_fd = temp_fd;
-            }
-            else
-            {
-                send_message(current_fd, "FAIL|10 Invalid|");
-                close(current_fd);
-                close(other_fd);
-                remove_active_player(p1_name);
-                remove_active_player(p2_name);
-                return;
-            }
+            resume_session(fd, token);
+            conn_free(idx);
+            continue;
         }
-    }
-    
-    // Clean up
-    remove_active_player(p1_name);
-    remove_active_player(p2_name);
-    close(p1_fd);
-    close(p2_fd);
-    printf("[GAME] Game ended successfully\n");
-}
+        if (admitted == LOBBY_REFUSED)
+            continue;
 
-// Handle child process termination
-void sigchld_handler(int sig)
-{
-    (void)sig;
-    while (waitpid(-1, NULL, WNOHANG) > 0);
+        *t_valid = trace_now();
+        return idx;
+    }
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc != 2)
+    int use_hugepages = 0;
+    int use_mux = 0;
+    char *cluster_port = NULL;
+    char *cluster_peers = NULL;
+    int opt;
+    char *admin_path = NULL;
+    int trace_sample = DEFAULT_TRACE_SAMPLE;
+    while ((opt = getopt(argc, argv, "Ha:s:t:T:g:mw:C:P:b:U:L:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'H':
+            use_hugepages = 1;
+            break;
+        case 'a':
+            archive_dir = optarg;
+            break;
+        case 's':
+            admin_path = optarg;
+            break;
+        case 't':
+            trace_path = optarg;
+            break;
+        case 'T':
+            trace_sample = atoi(optarg);
+            break;
+        case 'g':
+            grace_seconds = atoi(optarg);
+            break;
+        case 'b':
+            busy_poll_usec = atoi(optarg);
+            break;
+        case 'w':
+            mux_workers = atoi(optarg);
+            break;
+        case 'm':
+            use_mux = 1;
+            break;
+        case 'C':
+            cluster_port = optarg;
+            break;
+        case 'P':
+            cluster_peers = optarg;
+            break;
+        case 'U':
+            unix_path = optarg;
+            break;
+        case 'L':
+            live_path = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-H] [-a archive_dir] [-s admin_socket] [-t trace.json] [-T sample_every] [-g grace_seconds] [-b spin_usec] [-m [-w workers]] [-C cluster_port -P host:port,...] [-U socket_path] [-L live_table] <port>\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // With -U the TCP port is optional
+    if (argc - optind > 1 || (argc - optind == 0 && !unix_path))
     {
-        fprintf(stderr, "Usage: %s <port>\n", argv[0]);
+        fprintf(stderr, "Usage: %s [-H] [-a archive_dir] [-s admin_socket] [-t trace.json] [-T sample_every] [-g grace_seconds] [-b spin_usec] [-m [-w workers]] [-C cluster_port -P host:port,...] [-U socket_path] [-L live_table] <port>\n", argv[0]);
+        return 1;
+    }
+    char *port = optind < argc ? argv[optind] : NULL;
+
+    if (archive_dir && archive_init(archive_dir) < 0)
+    {
+        fprintf(stderr, "Cannot use archive %s\n", archive_dir);
         return 1;
     }
     
@@ -445,152 +804,329 @@ int main(int argc, char *argv[])
     }
     
     active_players->count = 0;
+
+    wait_stats = mmap(NULL, sizeof(WaitStats), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    net_stats = mmap(NULL, sizeof(NetStats), PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (wait_stats == MAP_FAILED || net_stats == MAP_FAILED)
+    {
+        perror("mmap failed");
+        return 1;
+    }
+
+    // Game processes are spread over the CPUs this server may run on
+    if (busy_poll_usec > 0)
+    {
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+        {
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            {
+                if (CPU_ISSET(cpu, &allowed))
+                    game_cpus[game_cpu_count++] = cpu;
+            }
+        }
+        if (game_cpu_count == 0)
+            game_cpus[game_cpu_count++] = 0;
+    }
+
+    // Set up the object pools for games, connections and read buffers
+    game_pool = slab_create(sizeof(Game), MAX_GAMES, use_hugepages);
+    conn_pool = slab_create(sizeof(Connection), MAX_CONNECTIONS, use_hugepages);
+    buffer_pool = slab_create(BUFFER_SIZE, MAX_CONNECTIONS, use_hugepages);
+    if (!game_pool || !conn_pool || !buffer_pool)
+    {
+        fprintf(stderr, "Failed to create object pools\n");
+        return 1;
+    }
+
+    for (int i = 0; i < MAX_GAMES; i++)
+        game_ctl[i] = -1;
+
+    // Each game shows its state in the live table slot of its game_pool
+    // index, for nimtop to read. Hub games follow, one slot per hub game.
+    if (live_path)
+    {
+        if (live_create(live_path, MAX_GAMES + (use_mux ? MUX_MAX_GAMES : 0), &live_games) < 0)
+            return 1;
+        live_table = &live_games;
+    }
+
+    player_stats = stats_create();
+    game_events = events_create(EVENT_RING_SIZE);
+    if (!player_stats || !game_events)
+        return 1;
+
+    tracer = trace_create(TRACE_SLOTS, trace_path && trace_sample > 0 ? trace_sample : 0);
+    if (!tracer)
+        return 1;
     
-    // Set up signal handler for child processes
-    signal(SIGCHLD, sigchld_handler);
-    
-    int server_fd = open_listener(argv[1], 10);
-    if (server_fd < 0)
+    // SIGCHLD reports game exits and SIGUSR1 dumps latency stats. Each
+    // handler also writes to the wake pipe, which the lobby polls along
+    // with its sockets, so they are handled promptly.
+    if (pipe(wake_pipe) < 0)
     {
+        perror("pipe");
         return 1;
     }
+    for (int i = 0; i < 2; i++)
+        fcntl(wake_pipe[i], F_SETFL, fcntl(wake_pipe[i], F_GETFL) | O_NONBLOCK);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = sigchld_handler;
+    sigaction(SIGCHLD, &sa, NULL);
+    sa.sa_handler = sigusr1_handler;
+    sigaction(SIGUSR1, &sa, NULL);
+    sa.sa_handler = sigusr2_handler;
+    sigaction(SIGUSR2, &sa, NULL);
     
-    printf("[SERVER] Listening on port %s\n", argv[1]);
-    printf("[SERVER] Concurrent game mode with extra credit enabled\n");
+    if (port)
+        listeners[listener_count++].fd = open_listener(port, 10);
+    if (unix_path)
+        listeners[listener_count++].fd = open_unix_listener(unix_path, 10);
+    for (int i = 0; i < listener_count; i++)
+    {
+        if (listeners[i].fd < 0)
+            return 1;
+        listeners[i].events = POLLIN;
+        fcntl(listeners[i].fd, F_SETFL, fcntl(listeners[i].fd, F_GETFL) | O_NONBLOCK);
+    }
+    listeners[listener_count].fd = wake_pipe[0];
+    listeners[listener_count].events = POLLIN;
     
-    while (1)
+    // Admin queries are answered by their own process so they never wait on
+    // the lobby, and read the stats table without blocking game processes
+    if (admin_path)
     {
-        // Wait for two players
-        printf("[SERVER] Waiting for Player 1...\n");
-        int p1_fd;
-        while ((p1_fd = accept(server_fd, NULL, NULL)) < 0)
+        int admin_fd = open_unix_listener(admin_path, 10);
+        if (admin_fd < 0)
+            return 1;
+
+        fflush(stdout);
+        pid_t admin_pid = fork();
+        if (admin_pid == 0)
         {
-            if (errno == EINTR)
-                continue;  // Interrupted by signal, retry
-            perror("Player 1 connection failed");
-            break;
+#ifdef __linux__
+            prctl(PR_SET_PDEATHSIG, SIGTERM);  // go away with the server
+#endif
+            signal(SIGUSR1, SIG_IGN);
+            close_listeners();
+            admin_serve(admin_fd, player_stats);
+            exit(1);
         }
-        if (p1_fd < 0)
-            continue;
-        printf("[SERVER] Player 1 connected\n");
-        
-        // Get Player 1 name
-        char buffer[1024];
-        int bytes = read(p1_fd, buffer, sizeof(buffer) - 1);
-        if (bytes <= 0)
+        else if (admin_pid < 0)
         {
-            close(p1_fd);
-            continue;
+            perror("fork failed");
+            return 1;
         }
-        buffer[bytes] = '\0';
-        
-        char *tokens[20];
-        int token_count = 0;
-        tokens[token_count] = strtok(buffer, "|");
-        while (tokens[token_count] != NULL && token_count < 19)
+        close(admin_fd);
+        printf("[SERVER] Admin socket on %s (PID: %d)\n", admin_path, admin_pid);
+    }
+
+    // Name claims are gossiped to the other nodes by their own process, so
+    // the lobby only ever does a local lookup
+    if (cluster_port)
+    {
+        cluster = cluster_create(cluster_port, cluster_peers);
+        if (!cluster)
+            return 1;
+        pid_t gossip_pid = cluster_start(cluster, getpid());
+        if (gossip_pid < 0)
+            return 1;
+        ClusterStats cs;
+        cluster_stats(cluster, &cs);
+        printf("[SERVER] Cluster node %08x gossiping on port %s (PID: %d)\n",
+               cs.node_id, cluster_port, gossip_pid);
+    }
+
+    // Multiplexed connections all live in one hub process, which runs
+    // their games as an event loop instead of a process per game
+    if (use_mux)
+    {
+        int sv[2];
+        mux_names = mux_names_create();
+        hub_events = events_create(HUB_EVENT_RING_SIZE);
+        mux_exec_stats = mmap(NULL, sizeof(ExecutorStats), PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (mux_exec_stats == MAP_FAILED)
+            mux_exec_stats = NULL;
+        if (!mux_names || !hub_events || !mux_exec_stats || socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0)
         {
-            token_count++;
-            tokens[token_count] = strtok(NULL, "|");
+            perror("mux setup failed");
+            return 1;
         }
-        
-        int msg_type = parse_messages(tokens, token_count);
-        if (msg_type != MSG_OPEN)
+
+        fflush(stdout);
+        pid_t mux_pid = fork();
+        if (mux_pid == 0)
         {
-            send_message(p1_fd, "FAIL|10 Invalid|");
-            close(p1_fd);
-            continue;
+#ifdef __linux__
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+#endif
+            signal(SIGUSR1, SIG_IGN);
+            close_listeners();
+            close(sv[0]);
+            MuxConfig config = {
+                .events = hub_events,
+                .wake_fd = wake_pipe[1],
+                .tracer = tracer,
+                .trace_slot = TRACE_MUX_SLOT,
+                .archive_dir = archive_dir,
+                .workers = mux_workers,
+                .exec_stats = mux_exec_stats,
+                .live = live_table,
+                .live_base = MAX_GAMES,
+            };
+            mux_serve(sv[1], &config);
+            exit(1);
         }
-        
-        char p1_name[MAX_NAME_LEN];
-        strncpy(p1_name, tokens[3], MAX_NAME_LEN - 1);
-        p1_name[MAX_NAME_LEN - 1] = '\0';
-        
-        // Check if player already active
-        if (is_player_active(p1_name))
+        else if (mux_pid < 0)
         {
-            send_message(p1_fd, "FAIL|22 Already Playing|");
-            close(p1_fd);
-            printf("[SERVER] Rejected duplicate player: %s\n", p1_name);
-            continue;
-        }
-        
-        printf("[SERVER] Player 1 name: %s\n", p1_name);
-        send_message(p1_fd, "WAIT|");
-        
-        // Wait for Player 2
-        printf("[SERVER] Waiting for Player 2...\n");
-        int p2_fd;
-        while ((p2_fd = accept(server_fd, NULL, NULL)) < 0)
-        {
-            if (errno == EINTR)
-                continue;  // Interrupted by signal, retry
-            perror("Player 2 connection failed");
-            break;
+            perror("fork failed");
+            return 1;
         }
-        if (p2_fd < 0)
+        close(sv[1]);
+        mux_ctl = sv[0];
+        printf("[SERVER] Multiplexed connections served by hub (PID: %d)\n", mux_pid);
+    }
+    
+    if (port)
+        printf("[SERVER] Listening on port %s\n", port);
+    if (unix_path)
+        printf("[SERVER] Listening on socket %s\n", unix_path);
+    printf("[SERVER] Concurrent game mode with extra credit enabled\n");
+    if (archive_dir)
+        printf("[SERVER] Archiving completed games to %s\n", archive_dir);
+    if (live_table)
+        printf("[SERVER] Publishing live games to %s\n", live_path);
+    if (grace_seconds > 0)
+        printf("[SERVER] Disconnected players may resume within %d s\n", grace_seconds);
+    if (busy_poll_usec > 0)
+        printf("[SERVER] Busy-poll: games spin %d us before sleeping, pinned across %d CPUs\n",
+               busy_poll_usec, game_cpu_count);
+    printf("[SERVER] Memory per game: %zu bytes (game %zu + 2 x connection %zu + 2 x buffer %zu)\n",
+           slab_stride(game_pool) + 2 * (slab_stride(conn_pool) + slab_stride(buffer_pool)),
+           slab_stride(game_pool), slab_stride(conn_pool), slab_stride(buffer_pool));
+    printf("[SERVER] Pools: %u games, %u connections, %zu bytes mapped%s\n",
+           slab_capacity(game_pool), slab_capacity(conn_pool),
+           slab_mapped_bytes(game_pool) + slab_mapped_bytes(conn_pool) +
+           slab_mapped_bytes(buffer_pool),
+           (slab_is_huge(game_pool) && slab_is_huge(conn_pool) && slab_is_huge(buffer_pool))
+               ? " (hugepages)" : "");
+    
+    slab_idx waiting = SLAB_NONE;
+    while (1)
+    {
+        // Wait for two players
+        uint64_t t_recv, t_valid;
+        slab_idx p1_idx = waiting;
+        waiting = SLAB_NONE;
+        if (p1_idx == SLAB_NONE)
         {
-            close(p1_fd);
-            continue;
+            p1_idx = accept_player(1, NULL, &t_recv, &t_valid);
+            printf("[SERVER] Player 1 name: %s\n", conn_get(p1_idx)->name);
+            send_message(conn_get(p1_idx)->fd, "WAIT|");
+            trace_spans(tracer, TRACE_LOBBY_SLOT, 0, t_recv, t_valid, trace_now());
         }
-        printf("[SERVER] Player 2 connected\n");
+        Connection *p1 = conn_get(p1_idx);
+        int p1_fd = p1->fd;
         
-        // Get Player 2 name
-        memset(buffer, 0, sizeof(buffer));
-        bytes = read(p2_fd, buffer, sizeof(buffer) - 1);
-        if (bytes <= 0)
+        slab_idx p2_idx = accept_player(2, p1->name, &t_recv, &t_valid);
+        Connection *p2 = conn_get(p2_idx);
+        int p2_fd = p2->fd;
+
+        printf("[SERVER] Player 2 name: %s\n", p2->name);
+
+        // Player 1's name may have been claimed elsewhere (on another node
+        // or in the hub) while they waited; if so, Player 2 waits instead
+        drain_events();
+        if (lobby_recheck(p1_idx) < 0)
         {
-            close(p1_fd);
-            close(p2_fd);
+            send_message(p2_fd, "WAIT|");
+            waiting = p2_idx;
             continue;
         }
-        buffer[bytes] = '\0';
-        
-        token_count = 0;
-        tokens[token_count] = strtok(buffer, "|");
-        while (tokens[token_count] != NULL && token_count < 19)
-        {
-            token_count++;
-            tokens[token_count] = strtok(NULL, "|");
-        }
-        
-        msg_type = parse_messages(tokens, token_count);
-        if (msg_type != MSG_OPEN)
+
+        // Keep SIGCHLD out until the game's pid is recorded, so the exit
+        // event of a game that ends instantly is always matched to it
+        sigset_t chld_mask, old_mask;
+        sigemptyset(&chld_mask);
+        sigaddset(&chld_mask, SIGCHLD);
+        sigprocmask(SIG_BLOCK, &chld_mask, &old_mask);
+
+        slab_idx game_idx = slab_alloc(game_pool);
+        if (game_idx == SLAB_NONE)
         {
-            send_message(p2_fd, "FAIL|10 Invalid|");
+            sigprocmask(SIG_SETMASK, &old_mask, NULL);
+            printf("[SERVER] Game pool exhausted, dropping players\n");
             close(p1_fd);
             close(p2_fd);
+            conn_free(p1_idx);
+            conn_free(p2_idx);
             continue;
         }
-        
-        char p2_name[MAX_NAME_LEN];
-        strncpy(p2_name, tokens[3], MAX_NAME_LEN - 1);
-        p2_name[MAX_NAME_LEN - 1] = '\0';
-        
-        // Check if player already active
-        if (is_player_active(p2_name))
+        Game *game = slab_get(game_pool, game_idx);
+        game->players[0] = p1_idx;
+        game->players[1] = p2_idx;
+        game->pid = 0;
+        game->evict = 0;
+
+        // With resume enabled, each seat gets a token and the game gets a
+        // channel on which the parent can pass it a reconnected socket
+        int ctl[2] = { -1, -1 };
+        if (grace_seconds > 0)
         {
-            send_message(p2_fd, "FAIL|22 Already Playing|");
-            close(p1_fd);
-            close(p2_fd);
-            printf("[SERVER] Rejected duplicate player: %s\n", p2_name);
-            continue;
+            make_token(game->tokens[0]);
+            make_token(game->tokens[1]);
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, ctl) < 0)
+            {
+                perror("socketpair");
+                ctl[0] = ctl[1] = -1;
+            }
         }
-        
-        printf("[SERVER] Player 2 name: %s\n", p2_name);
+
+        // Claim both names before forking so no duplicate can slip in
+        // while the game process starts
+        add_active_player(p1->name);
+        add_active_player(p2->name);
+        game->registered = 1;
         
         // Fork to handle game
+        fflush(stdout);
         pid_t pid = fork();
         
         if (pid == 0)
         {
             // Child process - handle the game
-            close(server_fd); // Don't need listener in child
-            handle_game(p1_fd, p2_fd, p1_name, p2_name);
+            signal(SIGUSR1, SIG_IGN);
+            sigprocmask(SIG_SETMASK, &old_mask, NULL);
+            close_listeners(); // Don't need listeners in child
+            for (int i = 0; i < MAX_GAMES; i++)
+            {
+                if (game_ctl[i] >= 0)
+                    close(game_ctl[i]);
+            }
+            if (ctl[0] >= 0)
+                close(ctl[0]);
+            uint64_t started = trace_now();
+            if (busy_poll_usec > 0)
+                pin_game(game_idx);
+            handle_game(game_idx, ctl[1]);
+            account_game(started);
+            trace_merge(tracer, game_idx, TRACE_RETIRED_SLOT);
             exit(0);
         }
         else if (pid > 0)
         {
             // Parent process - close player fds and continue accepting
+            game->pid = pid;
+            game_ctl[game_idx] = ctl[0];
+            if (ctl[1] >= 0)
+                close(ctl[1]);
+            sigprocmask(SIG_SETMASK, &old_mask, NULL);
+            trace_spans(tracer, TRACE_LOBBY_SLOT, 0, t_recv, t_valid, trace_now());
             close(p1_fd);
             close(p2_fd);
             printf("[SERVER] Forked game process (PID: %d)\n", pid);
@@ -600,10 +1136,38 @@ int main(int argc, char *argv[])
             perror("fork failed");
             close(p1_fd);
             close(p2_fd);
+            if (ctl[0] >= 0)
+            {
+                close(ctl[0]);
+                close(ctl[1]);
+            }
+            unregister_players(game);
+            game_free(game_idx);
+            sigprocmask(SIG_SETMASK, &old_mask, NULL);
         }
     }
     
+    events_destroy(game_events);
+    events_destroy(hub_events);
+    trace_destroy(tracer);
+    stats_destroy(player_stats);
+    slab_destroy(buffer_pool);
+    slab_destroy(conn_pool);
+    slab_destroy(game_pool);
     munmap(active_players, sizeof(ActivePlayers));
-    close(server_fd);
+    munmap(wait_stats, sizeof(WaitStats));
+    munmap(net_stats, sizeof(NetStats));
+    if (mux_names)
+        mux_names_destroy(mux_names);
+    if (cluster)
+        cluster_destroy(cluster);
+    close_listeners();
+    if (unix_path)
+        unlink(unix_path);
+    if (live_table)
+    {
+        live_close(live_table);
+        unlink(live_path);
+    }
     return 0;
 }
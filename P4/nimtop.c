@@ -0,0 +1,240 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include "live.h"
+
+// Live view of a running server's games, read from its live game table
+// (nimd_concurrent -L). The table is mapped read-only: nimtop never sends
+// the server a message, and the games never wait for it.
+
+#define DEFAULT_INTERVAL 1.0
+#define DEFAULT_STUCK 30
+#define DEFAULT_HOT 5
+#define SHOWN_NAME_LEN 16
+
+// One player's message rate, for the hot list
+typedef struct {
+    const char *name;
+    uint32_t msgs;
+    double rate;
+} HotPlayer;
+
+// Everything kept from one frame to the next
+typedef struct {
+    LiveTable table;
+    LiveGame *games;
+    LiveGame *prev;               // the games as of the last frame
+    uint64_t prev_at;
+    uint8_t *gone;                // game process no longer exists
+    HotPlayer *hot;
+    int stuck_seconds;
+    int hot_count;
+} View;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int by_rate(const void *a, const void *b)
+{
+    const HotPlayer *x = a, *y = b;
+    return (x->rate < y->rate) - (x->rate > y->rate);
+}
+
+// Messages per second since the last frame if the same game was seen
+// then, otherwise since the game started
+static double msg_rate(const LiveGame *game, const LiveGame *prev, uint64_t prev_at,
+                       uint64_t now, int player)
+{
+    if (prev->state == LIVE_PLAYING && prev->started == game->started && now > prev_at)
+        return (game->msgs[player] - prev->msgs[player]) * 1e9 / (now - prev_at);
+    if (now > game->started)
+        return game->msgs[player] * 1e9 / (now - game->started);
+    return 0;
+}
+
+// Print one frame: the games, then the busiest players
+static void show(View *view)
+{
+    const LiveTable *table = &view->table;
+    LiveGame *games = view->games;
+    uint64_t t0 = now_ns();
+    int torn = 0;
+    for (uint32_t i = 0; i < table->slot_count; i++)
+    {
+        if (live_read(table, i, &games[i]) < 0)
+        {
+            games[i].state = LIVE_FREE;
+            torn++;
+        }
+    }
+    uint64_t now = now_ns();
+    double read_us = (now - t0) / 1e3;
+
+    int live = 0, stuck = 0, gone = 0, hot_len = 0;
+    uint64_t stuck_ns = (uint64_t)view->stuck_seconds * 1000000000ull;
+    for (uint32_t i = 0; i < table->slot_count; i++)
+    {
+        if (games[i].state != LIVE_PLAYING)
+            continue;
+        live++;
+        if (now - games[i].last_active >= stuck_ns)
+            stuck++;
+        view->gone[i] = kill(games[i].pid, 0) < 0 && errno == ESRCH;
+        gone += view->gone[i];
+    }
+
+    printf("nimtop - %d live, %d stuck (idle %d s+), %d gone   server %d, %u slots, read in %.1f us\n",
+           live, stuck, view->stuck_seconds, gone, table->server_pid, table->slot_count, read_us);
+    if (torn)
+        printf("(%d slots were mid-update on every try)\n", torn);
+    printf("\n%4s %7s  %-*s %-*s %4s %5s  %-10s %8s %8s  %s\n",
+           "SLOT", "PID", SHOWN_NAME_LEN, "PLAYER 1", SHOWN_NAME_LEN, "PLAYER 2",
+           "TURN", "MOVES", "BOARD", "AGE", "IDLE", "STATE");
+
+    for (uint32_t i = 0; i < table->slot_count; i++)
+    {
+        const LiveGame *g = &games[i];
+        if (g->state != LIVE_PLAYING)
+            continue;
+
+        char board[24];
+        snprintf(board, sizeof(board), "%u %u %u %u %u",
+                 g->board[0], g->board[1], g->board[2], g->board[3], g->board[4]);
+        char state[32] = "";
+        if (g->held)
+            snprintf(state, sizeof(state), "held P%u ", g->held);
+        if (now - g->last_active >= stuck_ns)
+            strcat(state, "stuck ");
+        if (view->gone[i])
+            strcat(state, "gone");
+
+        printf("%4u %7d  %-*.*s %-*.*s %4u %5u  %-10s %7.1fs %7.1fs  %s\n",
+               i, g->pid, SHOWN_NAME_LEN, SHOWN_NAME_LEN, g->names[0],
+               SHOWN_NAME_LEN, SHOWN_NAME_LEN, g->names[1], g->turn, g->moves, board,
+               (now - g->started) / 1e9, (now - g->last_active) / 1e9, state);
+
+        for (int p = 0; p < 2; p++)
+        {
+            if (g->msgs[p] == 0)
+                continue;
+            HotPlayer *h = &view->hot[hot_len++];
+            h->name = g->names[p];
+            h->msgs = g->msgs[p];
+            h->rate = msg_rate(g, &view->prev[i], view->prev_at, now, p);
+        }
+    }
+
+    qsort(view->hot, hot_len, sizeof(HotPlayer), by_rate);
+    // Players who went quiet since the last frame are not hot
+    while (hot_len > 0 && view->hot[hot_len - 1].rate <= 0)
+        hot_len--;
+    printf("\nHot players (messages/s)\n");
+    for (int i = 0; i < hot_len && i < view->hot_count; i++)
+        printf("  %-*.*s %8.1f/s %8u msgs\n", SHOWN_NAME_LEN, SHOWN_NAME_LEN,
+               view->hot[i].name, view->hot[i].rate, view->hot[i].msgs);
+    if (hot_len == 0)
+        printf("  (none)\n");
+
+    // This frame is the baseline for the next one's rates
+    view->games = view->prev;
+    view->prev = games;
+    view->prev_at = now;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-i seconds] [-n frames] [-s stuck_seconds] [-k hot_players] <live_table>\n", prog);
+    fprintf(stderr, "  -i seconds        time between frames (default %.0f)\n", DEFAULT_INTERVAL);
+    fprintf(stderr, "  -n frames         stop after this many frames (default: run until killed)\n");
+    fprintf(stderr, "  -s stuck_seconds  idle time that marks a game stuck (default %d)\n", DEFAULT_STUCK);
+    fprintf(stderr, "  -k hot_players    length of the hot player list (default %d)\n", DEFAULT_HOT);
+}
+
+int main(int argc, char *argv[])
+{
+    double interval = DEFAULT_INTERVAL;
+    int frames = 0;
+    int stuck_seconds = DEFAULT_STUCK;
+    int hot_count = DEFAULT_HOT;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:n:s:k:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'i':
+            interval = atof(optarg);
+            break;
+        case 'n':
+            frames = atoi(optarg);
+            break;
+        case 's':
+            stuck_seconds = atoi(optarg);
+            break;
+        case 'k':
+            hot_count = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc - optind != 1 || interval <= 0 || stuck_seconds < 0)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    View view;
+    memset(&view, 0, sizeof(view));
+    view.stuck_seconds = stuck_seconds;
+    view.hot_count = hot_count;
+    if (live_open(argv[optind], &view.table) < 0)
+        return 1;
+
+    uint32_t slots = view.table.slot_count;
+    view.games = calloc(slots, sizeof(LiveGame));
+    view.prev = calloc(slots, sizeof(LiveGame));
+    view.gone = calloc(slots, 1);
+    view.hot = calloc(2 * slots + 1, sizeof(HotPlayer));
+    if (!view.games || !view.prev || !view.gone || !view.hot)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    // Redraw in place on a terminal; append frames otherwise
+    int redraw = isatty(STDOUT_FILENO) && frames != 1;
+    for (int frame = 0; frames == 0 || frame < frames; frame++)
+    {
+        if (frame > 0)
+        {
+            struct timespec pause;
+            pause.tv_sec = (time_t)interval;
+            pause.tv_nsec = (long)((interval - pause.tv_sec) * 1e9);
+            nanosleep(&pause, NULL);
+        }
+        if (redraw)
+            printf("\033[H\033[2J");
+        else if (frame > 0)
+            printf("\n");
+
+        show(&view);
+        fflush(stdout);
+    }
+
+    free(view.games);
+    free(view.prev);
+    free(view.gone);
+    free(view.hot);
+    live_close(&view.table);
+    return 0;
+}
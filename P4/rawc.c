@@ -1,6 +1,7 @@
 #define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <poll.h>
 #include "network.h"
@@ -11,12 +12,15 @@
 int
 main (int argc, char **argv)
 {
-    if (argc < 3) {
+    // a path (anything with a '/') names a Unix socket on this host
+    int by_path = argc >= 2 && strchr (argv[1], '/') != NULL;
+    if (argc < 3 && !by_path) {
 	printf ("Usage: %s host port\n", argv[0]);
+	printf ("       %s socket_path\n", argv[0]);
 	exit (EXIT_FAILURE);
     }
 
-    int sock = connect_inet (argv[1], argv[2]);
+    int sock = by_path ? connect_unix (argv[1]) : connect_inet (argv[1], argv[2]);
     if (sock < 0) exit (EXIT_FAILURE);
 
     struct pollfd pfds[2];
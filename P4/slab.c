@@ -0,0 +1,164 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "slab.h"
+
+#define SLAB_ALIGN 64
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+#define ROUND_UP(n, a) (((n) + (a) - 1) / (a) * (a))
+
+// Pool header, placed at the start of the shared mapping. Objects follow it.
+// The free list is a Treiber stack threaded through the first word of each
+// free object. The head packs a 32-bit ABA tag above the 32-bit index so it
+// can be swapped with a single CAS from any process sharing the mapping.
+struct Slab {
+    uint64_t head;
+    uint32_t in_use;
+    uint32_t capacity;
+    size_t stride;
+    size_t map_len;
+    int huge;
+};
+
+#define HEADER_SIZE ROUND_UP(sizeof(struct Slab), SLAB_ALIGN)
+
+// Create a pool of capacity fixed-size objects in MAP_SHARED memory so that
+// forked game processes see the same pool. Falls back to normal pages when
+// hugepages are requested but unavailable.
+Slab *slab_create(size_t obj_size, uint32_t capacity, int use_hugepages)
+{
+    if (capacity == 0 || capacity == SLAB_NONE)
+        return NULL;
+
+    // Free objects hold the next index, so every object must fit one
+    size_t stride = ROUND_UP(obj_size < sizeof(slab_idx) ? sizeof(slab_idx) : obj_size,
+                             SLAB_ALIGN);
+    size_t len = HEADER_SIZE + stride * capacity;
+    void *mem = MAP_FAILED;
+    int huge = 0;
+
+#ifdef MAP_HUGETLB
+    if (use_hugepages)
+    {
+        mem = mmap(NULL, ROUND_UP(len, HUGEPAGE_SIZE), PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED)
+        {
+            len = ROUND_UP(len, HUGEPAGE_SIZE);
+            huge = 1;
+        }
+    }
+#else
+    (void)use_hugepages;
+#endif
+
+    if (mem == MAP_FAILED)
+    {
+        mem = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED)
+        {
+            perror("slab mmap failed");
+            return NULL;
+        }
+    }
+
+    Slab *slab = mem;
+    slab->in_use = 0;
+    slab->capacity = capacity;
+    slab->stride = stride;
+    slab->map_len = len;
+    slab->huge = huge;
+
+    // Chain every object onto the free list in index order
+    for (uint32_t i = 0; i < capacity; i++)
+    {
+        *(slab_idx *)slab_get(slab, i) = (i + 1 < capacity) ? i + 1 : SLAB_NONE;
+    }
+    slab->head = 0;
+
+    return slab;
+}
+
+// Unmap the pool. Objects still in use become invalid.
+void slab_destroy(Slab *slab)
+{
+    if (slab)
+        munmap(slab, slab->map_len);
+}
+
+// Pop an object off the free list. Returns SLAB_NONE when the pool is empty.
+// Contents of the returned object are unspecified.
+slab_idx slab_alloc(Slab *slab)
+{
+    uint64_t old = __atomic_load_n(&slab->head, __ATOMIC_ACQUIRE);
+    for (;;)
+    {
+        slab_idx idx = (slab_idx)old;
+        if (idx == SLAB_NONE)
+            return SLAB_NONE;
+
+        // May read a stale link if another process wins the race; the tag
+        // then makes the CAS below fail and we retry with the new head
+        slab_idx next = __atomic_load_n((slab_idx *)slab_get(slab, idx), __ATOMIC_RELAXED);
+        uint64_t new_head = (((old >> 32) + 1) << 32) | next;
+        if (__atomic_compare_exchange_n(&slab->head, &old, new_head, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            __atomic_fetch_add(&slab->in_use, 1, __ATOMIC_RELAXED);
+            return idx;
+        }
+    }
+}
+
+// Push an object back onto the free list. Safe to call from a signal handler.
+void slab_free(Slab *slab, slab_idx idx)
+{
+    if (idx >= slab->capacity)
+        return;
+
+    uint64_t old = __atomic_load_n(&slab->head, __ATOMIC_ACQUIRE);
+    for (;;)
+    {
+        __atomic_store_n((slab_idx *)slab_get(slab, idx), (slab_idx)old, __ATOMIC_RELAXED);
+        uint64_t new_head = (((old >> 32) + 1) << 32) | idx;
+        if (__atomic_compare_exchange_n(&slab->head, &old, new_head, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            break;
+    }
+    __atomic_fetch_sub(&slab->in_use, 1, __ATOMIC_RELAXED);
+}
+
+// Translate an index into the object's address in this process
+void *slab_get(Slab *slab, slab_idx idx)
+{
+    return (char *)slab + HEADER_SIZE + (size_t)idx * slab->stride;
+}
+
+// Bytes each object actually occupies, including alignment padding
+size_t slab_stride(Slab *slab)
+{
+    return slab->stride;
+}
+
+size_t slab_mapped_bytes(Slab *slab)
+{
+    return slab->map_len;
+}
+
+uint32_t slab_capacity(Slab *slab)
+{
+    return slab->capacity;
+}
+
+uint32_t slab_in_use(Slab *slab)
+{
+    return __atomic_load_n(&slab->in_use, __ATOMIC_RELAXED);
+}
+
+int slab_is_huge(Slab *slab)
+{
+    return slab->huge;
+}
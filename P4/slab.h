@@ -0,0 +1,25 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Objects in a slab are addressed by 32-bit index rather than by pointer
+typedef uint32_t slab_idx;
+
+#define SLAB_NONE UINT32_MAX
+
+typedef struct Slab Slab;
+
+Slab *slab_create(size_t obj_size, uint32_t capacity, int use_hugepages);
+void slab_destroy(Slab *slab);
+slab_idx slab_alloc(Slab *slab);
+void slab_free(Slab *slab, slab_idx idx);
+void *slab_get(Slab *slab, slab_idx idx);
+size_t slab_stride(Slab *slab);
+size_t slab_mapped_bytes(Slab *slab);
+uint32_t slab_capacity(Slab *slab);
+uint32_t slab_in_use(Slab *slab);
+int slab_is_huge(Slab *slab);
+
+#endif
@@ -0,0 +1,216 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include "stats.h"
+
+// Player stats table in shared memory. Writers take a short spinlock among
+// themselves; readers never take it. Instead they retry under
+// a sequence lock, so an admin query can never hold up a game.
+struct StatsTable {
+    uint32_t lock;                // writer-only spinlock
+    uint32_t seq;                 // odd while a write is in progress
+    uint32_t count;
+    uint32_t board_len;
+    uint32_t board[LEADERBOARD_SIZE];   // slot indexes, most wins first
+    PlayerStats slots[STATS_CAPACITY];  // open addressing, empty name = free
+};
+
+// FNV-1a over the player name
+static uint32_t hash_name(const char *name)
+{
+    uint32_t h = 2166136261u;
+    for (; *name; name++)
+    {
+        h ^= (unsigned char)*name;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+StatsTable *stats_create(void)
+{
+    StatsTable *stats = mmap(NULL, sizeof(StatsTable), PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (stats == MAP_FAILED)
+    {
+        perror("stats mmap failed");
+        return NULL;
+    }
+    return stats;
+}
+
+void stats_destroy(StatsTable *stats)
+{
+    if (stats)
+        munmap(stats, sizeof(StatsTable));
+}
+
+// Find a player's slot, or the free slot where it would go. Returns -1 if the
+// player is absent and the table is full.
+static int find_slot(StatsTable *stats, const char *name)
+{
+    uint32_t start = hash_name(name) % STATS_CAPACITY;
+    for (uint32_t i = 0; i < STATS_CAPACITY; i++)
+    {
+        uint32_t slot = (start + i) % STATS_CAPACITY;
+        if (stats->slots[slot].name[0] == '\0' ||
+            strncmp(stats->slots[slot].name, name, STATS_NAME_LEN) == 0)
+            return slot;
+    }
+    return -1;
+}
+
+// Find or create a player's slot. Caller holds the write lock.
+static int get_slot(StatsTable *stats, const char *name)
+{
+    int slot = find_slot(stats, name);
+    if (slot < 0)
+        return -1;
+    if (stats->slots[slot].name[0] == '\0')
+    {
+        strncpy(stats->slots[slot].name, name, STATS_NAME_LEN - 1);
+        stats->count++;
+    }
+    return slot;
+}
+
+// Keep the leaderboard sorted after a player's win count went up. Only this
+// player can have moved, so one pass over LEADERBOARD_SIZE entries suffices.
+static void update_leaderboard(StatsTable *stats, uint32_t slot)
+{
+    uint32_t wins = stats->slots[slot].wins;
+    int pos = -1;
+    for (uint32_t i = 0; i < stats->board_len; i++)
+    {
+        if (stats->board[i] == slot)
+        {
+            pos = i;
+            break;
+        }
+    }
+
+    if (pos < 0)
+    {
+        if (stats->board_len < LEADERBOARD_SIZE)
+            pos = stats->board_len++;
+        else if (wins > stats->slots[stats->board[LEADERBOARD_SIZE - 1]].wins)
+            pos = LEADERBOARD_SIZE - 1;
+        else
+            return;
+        stats->board[pos] = slot;
+    }
+
+    while (pos > 0 && stats->slots[stats->board[pos - 1]].wins < wins)
+    {
+        stats->board[pos] = stats->board[pos - 1];
+        stats->board[pos - 1] = slot;
+        pos--;
+    }
+}
+
+static void write_begin(StatsTable *stats)
+{
+    while (__atomic_exchange_n(&stats->lock, 1, __ATOMIC_ACQUIRE))
+        sched_yield();
+    __atomic_store_n(&stats->seq, stats->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void write_end(StatsTable *stats)
+{
+    __atomic_store_n(&stats->seq, stats->seq + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&stats->lock, 0, __ATOMIC_RELEASE);
+}
+
+// Apply the result of one game to both players as a single update
+int stats_record_game(StatsTable *stats, const char *winner, const char *loser,
+                      int forfeit, time_t now)
+{
+    write_begin(stats);
+
+    int w = get_slot(stats, winner);
+    int l = get_slot(stats, loser);
+    if (w >= 0)
+    {
+        PlayerStats *p = &stats->slots[w];
+        p->wins++;
+        p->streak = p->streak > 0 ? p->streak + 1 : 1;
+        if ((uint32_t)p->streak > p->best_streak)
+            p->best_streak = p->streak;
+        p->last_seen = now;
+        update_leaderboard(stats, w);
+    }
+    if (l >= 0)
+    {
+        PlayerStats *p = &stats->slots[l];
+        p->losses++;
+        p->forfeits += forfeit ? 1 : 0;
+        p->streak = p->streak < 0 ? p->streak - 1 : -1;
+        p->last_seen = now;
+    }
+
+    write_end(stats);
+    return (w >= 0 && l >= 0) ? 0 : -1;
+}
+
+static uint32_t read_begin(StatsTable *stats)
+{
+    uint32_t seq;
+    while ((seq = __atomic_load_n(&stats->seq, __ATOMIC_ACQUIRE)) & 1)
+        sched_yield();
+    return seq;
+}
+
+static int read_retry(StatsTable *stats, uint32_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&stats->seq, __ATOMIC_RELAXED) != seq;
+}
+
+// Copy out one player's record. Returns -1 if the player has no games.
+int stats_lookup(StatsTable *stats, const char *name, PlayerStats *out)
+{
+    int found;
+    uint32_t seq;
+    do
+    {
+        seq = read_begin(stats);
+        int slot = find_slot(stats, name);
+        found = slot >= 0 && stats->slots[slot].name[0] != '\0';
+        if (found)
+            memcpy(out, &stats->slots[slot], sizeof(*out));
+    } while (read_retry(stats, seq));
+
+    if (found)
+        out->name[STATS_NAME_LEN - 1] = '\0';
+    return found ? 0 : -1;
+}
+
+// Copy out up to max leaderboard entries, most wins first
+int stats_leaderboard(StatsTable *stats, PlayerStats *out, int max)
+{
+    int n;
+    uint32_t seq;
+    do
+    {
+        seq = read_begin(stats);
+        n = stats->board_len;
+        if (n > max)
+            n = max;
+        if (n > LEADERBOARD_SIZE)
+            n = LEADERBOARD_SIZE;
+        for (int i = 0; i < n; i++)
+            memcpy(&out[i], &stats->slots[stats->board[i] % STATS_CAPACITY], sizeof(*out));
+    } while (read_retry(stats, seq));
+
+    for (int i = 0; i < n; i++)
+        out[i].name[STATS_NAME_LEN - 1] = '\0';
+    return n;
+}
+
+uint32_t stats_player_count(StatsTable *stats)
+{
+    return __atomic_load_n(&stats->count, __ATOMIC_RELAXED);
+}
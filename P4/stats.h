@@ -0,0 +1,32 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define STATS_CAPACITY 4096
+#define STATS_NAME_LEN 73
+#define LEADERBOARD_SIZE 10
+
+// Lifetime record of one player
+typedef struct {
+    char name[STATS_NAME_LEN];
+    uint32_t wins;
+    uint32_t losses;
+    uint32_t forfeits;            // games lost by forfeit
+    int32_t streak;               // > 0 consecutive wins, < 0 consecutive losses
+    uint32_t best_streak;
+    int64_t last_seen;            // seconds since the epoch
+} PlayerStats;
+
+typedef struct StatsTable StatsTable;
+
+StatsTable *stats_create(void);
+void stats_destroy(StatsTable *stats);
+int stats_record_game(StatsTable *stats, const char *winner, const char *loser,
+                      int forfeit, time_t now);
+int stats_lookup(StatsTable *stats, const char *name, PlayerStats *out);
+int stats_leaderboard(StatsTable *stats, PlayerStats *out, int max);
+uint32_t stats_player_count(StatsTable *stats);
+
+#endif
@@ -27,21 +27,28 @@ void send_ngp_message(int sock, const char *format, ...)
 
 int main(int argc, char **argv)
 {
-    if (argc < 4)
+    // A server on this host can also be reached by its Unix socket path
+    int by_path = argc >= 2 && strchr(argv[1], '/') != NULL;
+    if (argc < (by_path ? 3 : 4))
     {
         printf("Usage: %s host port player_name\n", argv[0]);
+        printf("       %s socket_path player_name\n", argv[0]);
         exit(EXIT_FAILURE);
     }
+    char *name = argv[by_path ? 2 : 3];
 
-    int sock = connect_inet(argv[1], argv[2]);
+    int sock = by_path ? connect_unix(argv[1]) : connect_inet(argv[1], argv[2]);
     if (sock < 0)
         exit(EXIT_FAILURE);
 
-    printf("Connected to %s:%s\n", argv[1], argv[2]);
-    printf("Playing as: %s\n", argv[3]);
+    if (by_path)
+        printf("Connected to %s\n", argv[1]);
+    else
+        printf("Connected to %s:%s\n", argv[1], argv[2]);
+    printf("Playing as: %s\n", name);
 
     // Send OPEN message with player name
-    send_ngp_message(sock, "OPEN|%s|", argv[3]);
+    send_ngp_message(sock, "OPEN|%s|", name);
 
     struct pollfd pfds[2];
     pfds[0].fd = STDIN_FILENO;
@@ -167,6 +174,14 @@ int main(int argc, char **argv)
             else if (strstr(buf, "FAIL"))
             {
                 printf(">> ERROR FROM SERVER: %s\n", buf);
+
+                // The server does not repeat PLAY after a rejected move
+                if (strstr(buf, "32 Pile Index") || strstr(buf, "33 Quantity"))
+                {
+                    printf(">> Still your turn. Enter move as 'pile stones': ");
+                    fflush(stdout);
+                    my_turn = 1;
+                }
             }
         }
 
@@ -0,0 +1,272 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "trace.h"
+
+#define TRACE_RING_SIZE 8192
+
+// One sampled span for the Chrome trace export
+typedef struct {
+    uint64_t seq;                 // ring position + 1 once the event is complete
+    uint64_t start_ns;
+    uint64_t dur_ns;
+    int32_t pid;
+    int32_t tid;
+    int32_t span;
+} TraceEvent;
+
+// One slot's histograms, and the messages it has seen for sampling. The
+// count lives with the slot, so games never share a cache line for it.
+typedef struct {
+    Histogram hists[SPAN_COUNT];
+    uint64_t samples;
+} TraceSlot;
+
+// Shared by every process: one set of histograms per slot, and a ring of
+// sampled events. Each slot has a single writer (its owning process), and
+// the parent only reads when dumping.
+struct Tracer {
+    size_t map_len;
+    int slots;
+    int sample_every;
+    uint64_t ring_head;
+    TraceEvent ring[TRACE_RING_SIZE];
+    TraceSlot slot[];
+};
+
+static const char *span_names[SPAN_COUNT] = {
+    "recv->validate",
+    "validate->send",
+    "recv->send",
+    "arrive->recv",
+    "net rtt",
+    "net rttvar",
+};
+
+const char *trace_span_name(int span)
+{
+    return span_names[span];
+}
+
+// Index of the bucket a value falls in
+static int bucket_index(uint64_t value)
+{
+    if (value < (1u << HIST_SUB_BITS))
+        return value;
+    if (value >= (1ull << HIST_MAX_BITS))
+        return HIST_BUCKETS - 1;
+    int msb = 63 - __builtin_clzll(value);
+    int shift = msb - (HIST_SUB_BITS - 1);
+    return (1 << HIST_SUB_BITS) + (msb - HIST_SUB_BITS) * HIST_HALF +
+           (int)(value >> shift) - HIST_HALF;
+}
+
+// Midpoint of the value range covered by a bucket
+static uint64_t bucket_value(int index)
+{
+    if (index < (1 << HIST_SUB_BITS))
+        return index;
+    int step = (index - (1 << HIST_SUB_BITS)) / HIST_HALF;
+    int sub = (index - (1 << HIST_SUB_BITS)) % HIST_HALF + HIST_HALF;
+    int shift = step + 1;
+    uint64_t low = (uint64_t)sub << shift;
+    return low + ((1ull << shift) >> 1);
+}
+
+// An empty histogram's min is UINT64_MAX, so the first value recorded or
+// merged in always replaces it
+void hist_clear(Histogram *hist)
+{
+    memset(hist, 0, sizeof(*hist));
+    hist->min = UINT64_MAX;
+}
+
+// Record one value. Only the slot's owner writes, but the parent may read
+// concurrently, so counters are updated with relaxed atomics.
+void hist_record(Histogram *hist, uint64_t value)
+{
+    __atomic_fetch_add(&hist->buckets[bucket_index(value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->sum, value, __ATOMIC_RELAXED);
+    if (value < __atomic_load_n(&hist->min, __ATOMIC_RELAXED))
+        __atomic_store_n(&hist->min, value, __ATOMIC_RELAXED);
+    if (value > __atomic_load_n(&hist->max, __ATOMIC_RELAXED))
+        __atomic_store_n(&hist->max, value, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+}
+
+// Add one histogram's counts into another. Exiting games merge into the
+// same retired slot at once, so min and max are raised or lowered with a
+// CAS loop rather than a load and a store that could undo another merge.
+void hist_add(Histogram *into, const Histogram *from)
+{
+    uint64_t count = __atomic_load_n(&from->count, __ATOMIC_RELAXED);
+    if (count == 0)
+        return;
+
+    uint64_t min = __atomic_load_n(&from->min, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&from->max, __ATOMIC_RELAXED);
+    uint64_t seen = __atomic_load_n(&into->min, __ATOMIC_RELAXED);
+    while (min < seen &&
+           !__atomic_compare_exchange_n(&into->min, &seen, min, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+    seen = __atomic_load_n(&into->max, __ATOMIC_RELAXED);
+    while (max > seen &&
+           !__atomic_compare_exchange_n(&into->max, &seen, max, 0,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+
+    for (int i = 0; i < HIST_BUCKETS; i++)
+    {
+        uint64_t n = __atomic_load_n(&from->buckets[i], __ATOMIC_RELAXED);
+        if (n)
+            __atomic_fetch_add(&into->buckets[i], n, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&into->sum, __atomic_load_n(&from->sum, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+    __atomic_fetch_add(&into->count, count, __ATOMIC_RELAXED);
+}
+
+// Value at the given percentile (0-100), clamped to the recorded range
+uint64_t hist_percentile(const Histogram *hist, double percentile)
+{
+    if (hist->count == 0)
+        return 0;
+
+    uint64_t target = (uint64_t)(hist->count * percentile / 100.0 + 0.5);
+    if (target == 0)
+        target = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++)
+    {
+        seen += hist->buckets[i];
+        if (seen >= target)
+        {
+            uint64_t value = bucket_value(i);
+            if (value < hist->min)
+                value = hist->min;
+            if (value > hist->max)
+                value = hist->max;
+            return value;
+        }
+    }
+    return hist->max;
+}
+
+// Map the tracer in shared memory; sample_every of 0 disables sampling
+Tracer *trace_create(int slots, int sample_every)
+{
+    size_t len = sizeof(Tracer) + (size_t)slots * sizeof(TraceSlot);
+    Tracer *tracer = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (tracer == MAP_FAILED)
+    {
+        perror("trace mmap failed");
+        return NULL;
+    }
+    tracer->map_len = len;
+    tracer->slots = slots;
+    tracer->sample_every = sample_every;
+    for (int slot = 0; slot < slots; slot++)
+    {
+        for (int span = 0; span < SPAN_COUNT; span++)
+            hist_clear(&tracer->slot[slot].hists[span]);
+    }
+    return tracer;
+}
+
+void trace_destroy(Tracer *tracer)
+{
+    if (tracer)
+        munmap(tracer, tracer->map_len);
+}
+
+static Histogram *slot_hist(Tracer *tracer, int slot, int span)
+{
+    return &tracer->slot[slot].hists[span];
+}
+
+static void push_event(Tracer *tracer, int span, int tid, uint64_t start, uint64_t end)
+{
+    uint64_t pos = __atomic_fetch_add(&tracer->ring_head, 1, __ATOMIC_RELAXED);
+    TraceEvent *ev = &tracer->ring[pos % TRACE_RING_SIZE];
+    __atomic_store_n(&ev->seq, 0, __ATOMIC_RELAXED);
+    ev->start_ns = start;
+    ev->dur_ns = end - start;
+    ev->pid = getpid();
+    ev->tid = tid;
+    ev->span = span;
+    __atomic_store_n(&ev->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+// Record the three spans of one handled message: received at recv,
+// validated at valid, and the last reply written at sent
+void trace_spans(Tracer *tracer, int slot, int tid, uint64_t recv, uint64_t valid, uint64_t sent)
+{
+    if (!tracer || slot < 0 || slot >= tracer->slots)
+        return;
+
+    hist_record(slot_hist(tracer, slot, SPAN_RECV_VALIDATE), valid - recv);
+    hist_record(slot_hist(tracer, slot, SPAN_VALIDATE_SEND), sent - valid);
+    hist_record(slot_hist(tracer, slot, SPAN_RECV_SEND), sent - recv);
+
+    if (tracer->sample_every > 0 && tracer->slot[slot].samples++ % tracer->sample_every == 0)
+    {
+        push_event(tracer, SPAN_RECV_SEND, tid, recv, sent);
+        push_event(tracer, SPAN_RECV_VALIDATE, tid, recv, valid);
+        push_event(tracer, SPAN_VALIDATE_SEND, tid, valid, sent);
+    }
+}
+
+// Record a single span that has no sampled trace event
+void trace_record(Tracer *tracer, int slot, int span, uint64_t value)
+{
+    if (!tracer || slot < 0 || slot >= tracer->slots)
+        return;
+    hist_record(slot_hist(tracer, slot, span), value);
+}
+
+// Fold one slot's histograms into another and clear the source
+void trace_merge(Tracer *tracer, int from, int into)
+{
+    for (int span = 0; span < SPAN_COUNT; span++)
+    {
+        hist_add(slot_hist(tracer, into, span), slot_hist(tracer, from, span));
+        hist_clear(slot_hist(tracer, from, span));
+    }
+}
+
+// Sum a span over a range of slots into out
+void trace_sum(Tracer *tracer, int first, int count, int span, Histogram *out)
+{
+    hist_clear(out);
+    for (int slot = first; slot < first + count && slot < tracer->slots; slot++)
+        hist_add(out, slot_hist(tracer, slot, span));
+}
+
+// Write the sampled events still in the ring as Chrome trace JSON
+int trace_write_json(Tracer *tracer, FILE *out)
+{
+    uint64_t head = __atomic_load_n(&tracer->ring_head, __ATOMIC_ACQUIRE);
+    uint64_t first = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+    int written = 0;
+
+    fprintf(out, "{\"traceEvents\":[\n");
+    for (uint64_t pos = first; pos < head; pos++)
+    {
+        TraceEvent ev = tracer->ring[pos % TRACE_RING_SIZE];
+        if (__atomic_load_n(&tracer->ring[pos % TRACE_RING_SIZE].seq, __ATOMIC_ACQUIRE) != pos + 1 ||
+            ev.seq != pos + 1 || ev.span < 0 || ev.span >= SPAN_COUNT)
+            continue;   // overwritten or still being written
+        fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                "\"ts\":%.3f,\"dur\":%.3f}",
+                written ? ",\n" : "", span_names[ev.span], ev.pid, ev.tid,
+                ev.start_ns / 1000.0, ev.dur_ns / 1000.0);
+        written++;
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    return written;
+}
@@ -0,0 +1,60 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// Log-linear (HDR style) histogram of nanosecond values. Values below
+// 2^HIST_SUB_BITS are exact; above that each power of two is split into
+// 2^(HIST_SUB_BITS-1) buckets, so any value is within ~1.6% of its bucket.
+// Values at or above 2^HIST_MAX_BITS ns (about 68 s) are clamped.
+#define HIST_SUB_BITS 6
+#define HIST_MAX_BITS 36
+#define HIST_HALF (1 << (HIST_SUB_BITS - 1))
+#define HIST_BUCKETS ((1 << HIST_SUB_BITS) + (HIST_MAX_BITS - HIST_SUB_BITS) * HIST_HALF)
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[HIST_BUCKETS];
+} Histogram;
+
+// Spans measured for every message the server handles
+enum {
+    SPAN_RECV_VALIDATE,
+    SPAN_VALIDATE_SEND,
+    SPAN_RECV_SEND,
+    SPAN_ARRIVE_RECV,             // kernel receive to read(): wakeup latency
+    SPAN_NET_RTT,                 // sampled TCP round-trip time
+    SPAN_NET_RTTVAR,
+    SPAN_COUNT
+};
+
+typedef struct Tracer Tracer;
+
+Tracer *trace_create(int slots, int sample_every);
+void trace_destroy(Tracer *tracer);
+void trace_spans(Tracer *tracer, int slot, int tid, uint64_t recv, uint64_t valid, uint64_t sent);
+void trace_record(Tracer *tracer, int slot, int span, uint64_t value);
+void trace_merge(Tracer *tracer, int from, int into);
+void trace_sum(Tracer *tracer, int first, int count, int span, Histogram *out);
+int trace_write_json(Tracer *tracer, FILE *out);
+const char *trace_span_name(int span);
+
+void hist_clear(Histogram *hist);
+void hist_record(Histogram *hist, uint64_t value);
+void hist_add(Histogram *into, const Histogram *from);
+uint64_t hist_percentile(const Histogram *hist, double percentile);
+
+// Monotonic timestamp in nanoseconds (vDSO, no syscall on Linux)
+static inline uint64_t trace_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+#endif